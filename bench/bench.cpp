@@ -0,0 +1,393 @@
+/**
+ * bench.cpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// usage: iopp_bench [FILE] [SIZE_MIB]
+//
+// Creates a scratch file of the given size (default: 256 MiB) at the given path (default: iopp_bench.tmp),
+// runs all benchmarks on it and deletes it afterwards.
+// The bitwise I/O and integer code benchmarks do not use the file; they process a fixed number of values in memory.
+//
+// Each measurement is printed as a single line of the form
+//   RESULT bench=<name> impl=<implementation> param=<parameter> bytes=<n> ops=<n> time_ms=<t> gbps=<x> ns_per_op=<x> check=<n>
+// which can be collected using, e.g., sqlplot-tools or grep and awk.
+// Note that the file is read from the page cache, i.e., results reflect warm-cache throughput.
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <iopp/bitwise_io.hpp>
+#include <iopp/codes.hpp>
+#include <iopp/file_input_stream.hpp>
+#include <iopp/file_output_stream.hpp>
+#include <iopp/load_file.hpp>
+#include <iopp/memory_mapped_file.hpp>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t KiB = 1024;
+constexpr size_t MiB = 1024 * KiB;
+
+constexpr size_t CHUNK_SIZE = 64 * KiB;
+constexpr size_t BUFFER_SIZES[] = { 4 * KiB, 16 * KiB, 64 * KiB, 1 * MiB };
+constexpr size_t BIT_WIDTHS[] = { 1, 7, 13, 32, 57, 64 };
+
+// the number of values for the bitwise and codes benchmarks, independent of the file size so that memory usage stays bounded
+constexpr size_t NUM_VALUES = size_t(1) << 24;
+
+// simple xorshift generator, we need reproducibility rather than quality
+struct Random {
+    uint64_t state;
+
+    uint64_t operator()() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+void result(std::string const& bench, std::string const& impl, std::string const& param, size_t const bytes, size_t const ops, Clock::duration const time, uint64_t const check) {
+    double const ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+    double const gbps = ns > 0 ? (double)bytes / ns : 0.0; // bytes per nanosecond = GB/s
+    double const ns_per_op = ops > 0 ? ns / (double)ops : 0.0;
+
+    std::cout << "RESULT bench=" << bench
+        << " impl=" << impl
+        << " param=" << param
+        << " bytes=" << bytes
+        << " ops=" << ops
+        << " time_ms=" << (ns / 1e6)
+        << " gbps=" << gbps
+        << " ns_per_op=" << ns_per_op
+        << " check=" << check
+        << std::endl;
+}
+
+template<typename F>
+void measure(std::string const& bench, std::string const& impl, std::string const& param, size_t const bytes, size_t const ops, F f) {
+    auto const t0 = Clock::now();
+    uint64_t const check = f();
+    auto const t1 = Clock::now();
+    result(bench, impl, param, bytes, ops, t1 - t0, check);
+}
+
+uint64_t checksum(char const* p, size_t const num) {
+    uint64_t sum = 0;
+    for(size_t i = 0; i < num; i++) sum += (unsigned char)p[i];
+    return sum;
+}
+
+void create_file(std::filesystem::path const& path, size_t const size) {
+    std::vector<char> chunk(CHUNK_SIZE);
+    Random rnd { 147 };
+    std::ofstream f(path, std::ios::binary);
+    for(size_t written = 0; written < size; written += CHUNK_SIZE) {
+        for(auto& c : chunk) c = (char)rnd();
+        f.write(chunk.data(), std::min(CHUNK_SIZE, size - written));
+    }
+}
+
+void bench_read(std::filesystem::path const& path, size_t const size) {
+    std::vector<char> chunk(CHUNK_SIZE);
+
+    for(auto const bufsize : BUFFER_SIZES) {
+        auto const param = std::to_string(bufsize);
+
+        measure("read", "FileInputStream::read", param, size, size / CHUNK_SIZE, [&](){
+            uint64_t sum = 0;
+            iopp::FileInputStream fin(path, 0, SIZE_MAX, bufsize);
+            while(fin) {
+                fin.read(chunk.data(), CHUNK_SIZE);
+                sum += checksum(chunk.data(), fin.gcount());
+            }
+            return sum;
+        });
+
+        measure("read", "FileInputStream::get", param, size, size, [&](){
+            uint64_t sum = 0;
+            iopp::FileInputStream fin(path, 0, SIZE_MAX, bufsize);
+            for(auto c = fin.get(); c != EOF; c = fin.get()) sum += (unsigned char)c;
+            return sum;
+        });
+    }
+
+    measure("read", "std::ifstream::read", std::to_string(CHUNK_SIZE), size, size / CHUNK_SIZE, [&](){
+        uint64_t sum = 0;
+        std::ifstream fin(path, std::ios::binary);
+        while(fin) {
+            fin.read(chunk.data(), CHUNK_SIZE);
+            sum += checksum(chunk.data(), fin.gcount());
+        }
+        return sum;
+    });
+
+    measure("read", "std::ifstream::get", "0", size, size, [&](){
+        uint64_t sum = 0;
+        std::ifstream fin(path, std::ios::binary);
+        for(auto c = fin.get(); c != EOF; c = fin.get()) sum += (unsigned char)c;
+        return sum;
+    });
+
+    measure("read", "fread", std::to_string(CHUNK_SIZE), size, size / CHUNK_SIZE, [&](){
+        uint64_t sum = 0;
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if(f) {
+            size_t n;
+            while((n = std::fread(chunk.data(), 1, CHUNK_SIZE, f)) > 0) sum += checksum(chunk.data(), n);
+            std::fclose(f);
+        }
+        return sum;
+    });
+}
+
+void bench_write(std::filesystem::path const& path, size_t const size) {
+    std::vector<char> chunk(CHUNK_SIZE);
+    Random rnd { 741 };
+    for(auto& c : chunk) c = (char)rnd();
+
+    auto const out_path = std::filesystem::path(path.string() + ".out");
+    size_t const wchunk = 4 * KiB;
+
+    for(auto const bufsize : BUFFER_SIZES) {
+        auto const param = std::to_string(bufsize);
+
+        measure("write", "FileOutputStream::write", param, size, size / wchunk, [&](){
+            iopp::FileOutputStream fout(out_path, bufsize);
+            for(size_t written = 0; written < size; written += wchunk) fout.write(chunk.data() + written % CHUNK_SIZE, wchunk);
+            return uint64_t(0);
+        });
+
+        measure("write", "FileOutputStream::put", param, size, size, [&](){
+            iopp::FileOutputStream fout(out_path, bufsize);
+            for(size_t i = 0; i < size; i++) fout.put(chunk[i % CHUNK_SIZE]);
+            return uint64_t(0);
+        });
+    }
+
+    measure("write", "std::ofstream::write", std::to_string(wchunk), size, size / wchunk, [&](){
+        std::ofstream fout(out_path, std::ios::binary);
+        for(size_t written = 0; written < size; written += wchunk) fout.write(chunk.data() + written % CHUNK_SIZE, wchunk);
+        return uint64_t(0);
+    });
+
+    measure("write", "std::ofstream::put", "0", size, size, [&](){
+        std::ofstream fout(out_path, std::ios::binary);
+        for(size_t i = 0; i < size; i++) fout.put(chunk[i % CHUNK_SIZE]);
+        return uint64_t(0);
+    });
+
+    measure("write", "fwrite", std::to_string(wchunk), size, size / wchunk, [&](){
+        FILE* f = std::fopen(out_path.c_str(), "wb");
+        if(f) {
+            for(size_t written = 0; written < size; written += wchunk) std::fwrite(chunk.data() + written % CHUNK_SIZE, 1, wchunk, f);
+            std::fclose(f);
+        }
+        return uint64_t(0);
+    });
+
+    std::filesystem::remove(out_path);
+}
+
+void bench_mmap(std::filesystem::path const& path, size_t const size) {
+    measure("mmap", "MemoryMappedFile::sequential", "0", size, size, [&](){
+        iopp::MemoryMappedFile mapped(path);
+        return checksum((char const*)mapped.data(), mapped.size());
+    });
+
+    size_t const num_random = size / 64;
+    measure("mmap", "MemoryMappedFile::random", "0", num_random, num_random, [&](){
+        iopp::MemoryMappedFile mapped(path);
+        auto const* data = (unsigned char const*)mapped.data();
+        size_t const n = mapped.size();
+
+        uint64_t sum = 0;
+        if(n > 0) {
+            Random rnd { 369 };
+            for(size_t i = 0; i < num_random; i++) sum += data[rnd() % n];
+        }
+        return sum;
+    });
+}
+
+void bench_load_file(std::filesystem::path const& path, size_t const size) {
+    measure("load_file", "load_file_str", "0", size, 1, [&](){
+        auto const s = iopp::load_file_str(path);
+        return uint64_t(s.size());
+    });
+}
+
+void bench_bitwise() {
+    for(auto const k : BIT_WIDTHS) {
+        size_t const num = NUM_VALUES;
+        size_t const bytes = (num * k + iopp::PACK_WORD_BITS - 1) / iopp::PACK_WORD_BITS * sizeof(iopp::PackWord); // the packed size, not including the finalizer
+        auto const param = std::to_string(k);
+
+        // generate values
+        std::vector<uint64_t> values(num);
+        {
+            Random rnd { 963 };
+            for(auto& x : values) x = rnd() & iopp::low_mask(k);
+        }
+
+        std::vector<iopp::PackWord> packed;
+        packed.reserve(num * k / iopp::PACK_WORD_BITS + 2);
+
+        measure("bitwise", "BitPacker::write", param, bytes, num, [&](){
+            packed.clear();
+            auto sink = iopp::BitPacker(std::back_inserter(packed));
+            for(auto const x : values) sink.write(x, k);
+            return uint64_t(sink.num_bits_written());
+        });
+
+        measure("bitwise", "BitUnpacker::read", param, bytes, num, [&](){
+            uint64_t sum = 0;
+            auto src = iopp::BitUnpacker(packed.begin(), packed.end());
+            for(size_t i = 0; i < num; i++) sum += src.read(k);
+            return sum;
+        });
+
+        measure("bitwise", "BitPacker::write_many", param, bytes, num, [&](){
+            packed.clear();
+            auto sink = iopp::BitPacker(std::back_inserter(packed));
+            sink.write_many(k, values.data(), num);
+            return uint64_t(sink.num_bits_written());
+        });
+
+        std::vector<uint64_t> out(num);
+        measure("bitwise", "BitUnpacker::read_many", param, bytes, num, [&](){
+            auto src = iopp::BitUnpacker(packed.begin(), packed.end());
+            src.read_many(k, out.data(), num);
+            uint64_t sum = 0;
+            for(auto const x : out) sum += x;
+            return sum;
+        });
+    }
+}
+
+// hides read_unary of a bit unpacker so that unary codes are decoded bit by bit
+template<typename Source>
+struct BitByBit {
+    Source src;
+    bool read() { return src.read(); }
+    auto read(size_t const num) { return src.read(num); }
+};
+
+void bench_codes() {
+    // generate small values with a roughly geometric distribution
+    size_t const num = NUM_VALUES;
+    std::vector<uint64_t> values(num);
+    {
+        Random rnd { 4711 };
+        for(auto& x : values) {
+            uint64_t const r = rnd();
+            size_t const w = std::countr_zero(r | 0x10000); // geometrically distributed bit width
+            x = (r >> 32) & ((uint64_t(1) << w) - 1);
+        }
+    }
+
+    // each code is encoded once before measuring, so that the packed size can be reported
+    std::vector<iopp::PackWord> packed;
+    auto packed_bytes = [&](){ return packed.size() * sizeof(iopp::PackWord); };
+
+    auto encode_gamma = [&](){
+        packed.clear();
+        auto sink = iopp::BitPacker(std::back_inserter(packed));
+        for(auto const x : values) iopp::write_gamma(sink, x + 1);
+        return uint64_t(sink.num_bits_written());
+    };
+    encode_gamma();
+    measure("codes", "write_gamma", "0", packed_bytes(), num, encode_gamma);
+    measure("codes", "read_gamma", "0", packed_bytes(), num, [&](){
+        uint64_t sum = 0;
+        auto src = iopp::BitUnpacker(packed.begin(), packed.end());
+        for(size_t i = 0; i < num; i++) sum += iopp::read_gamma(src);
+        return sum;
+    });
+    measure("codes", "read_gamma_bitwise", "0", packed_bytes(), num, [&](){
+        uint64_t sum = 0;
+        BitByBit src { iopp::BitUnpacker(packed.begin(), packed.end()) };
+        for(size_t i = 0; i < num; i++) sum += iopp::read_gamma(src);
+        return sum;
+    });
+
+    auto encode_rice = [&](){
+        packed.clear();
+        auto sink = iopp::BitPacker(std::back_inserter(packed));
+        for(auto const x : values) iopp::write_rice(sink, x, 4);
+        return uint64_t(sink.num_bits_written());
+    };
+    encode_rice();
+    measure("codes", "write_rice", "4", packed_bytes(), num, encode_rice);
+    measure("codes", "read_rice", "4", packed_bytes(), num, [&](){
+        uint64_t sum = 0;
+        auto src = iopp::BitUnpacker(packed.begin(), packed.end());
+        for(size_t i = 0; i < num; i++) sum += iopp::read_rice(src, 4);
+        return sum;
+    });
+
+    std::vector<char> bytes(num * iopp::VBYTE_MAX_BYTES);
+    char* end = iopp::encode_vbyte_many(values.data(), num, bytes.data());
+    size_t const vbyte_bytes = end - bytes.data();
+    measure("codes", "encode_vbyte_many", "0", vbyte_bytes, num, [&](){
+        end = iopp::encode_vbyte_many(values.data(), num, bytes.data());
+        return uint64_t(end - bytes.data());
+    });
+    std::vector<uint64_t> out(num);
+    measure("codes", "decode_vbyte_many", "0", vbyte_bytes, num, [&](){
+        iopp::decode_vbyte_many((char const*)bytes.data(), (char const*)end, out.data(), num);
+        uint64_t sum = 0;
+        for(auto const x : out) sum += x;
+        return sum;
+    });
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path const path = (argc > 1) ? argv[1] : "iopp_bench.tmp";
+    size_t const size = ((argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 256) * MiB;
+
+    create_file(path, size);
+    bench_read(path, size);
+    bench_write(path, size);
+    bench_mmap(path, size);
+    bench_load_file(path, size);
+    bench_bitwise();
+    bench_codes();
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,504 @@
+/**
+ * async_file_input_stream.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_ASYNC_FILE_INPUT_STREAM_HPP
+#define _IOPP_ASYNC_FILE_INPUT_STREAM_HPP
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "buffer_size.hpp"
+#include "stream_input_iterator.hpp"
+#include "util/buffer_pool.hpp"
+#include "os/posix.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#else
+#include <fstream>
+#endif
+
+namespace iopp {
+
+/**
+ * \brief \ref iopp::STLInputStreamLike "Standard input stream like" file input stream with asynchronous read-ahead
+ * 
+ * This stream behaves like \ref FileInputStream , but the reading is done by a background thread that keeps a number of buffers filled ahead of the current reading position.
+ * This way, processing the input and reading it from the disk can overlap.
+ * 
+ * Seeking discards all buffers that have been read ahead; buffers that are currently being filled are dropped as soon as the read completes.
+ * 
+ * On POSIX systems, the buffers are filled using `pread`.
+ * The default implementation is backed by a `std::ifstream` which is only accessed by the background thread.
+ */
+class AsyncFileInputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+private:
+    using uchar_type = unsigned char;
+
+    struct Buffer {
+        AlignedBuffer data;
+        size_t offset; // offset in file
+        size_t size;   // number of valid bytes
+    };
+
+    // state shared with the background thread
+    // this is kept on the heap so that the stream can be moved while the thread is running
+    struct Shared {
+        size_t begin;
+        size_t end;
+        size_t bufsize;
+
+        #ifdef IOPP_POSIX
+        int fd;
+        #else
+        std::ifstream fstream;
+        #endif
+
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        std::vector<Buffer> buffers;
+        std::vector<size_t> free;  // buffers available to the background thread
+        std::deque<size_t> ready;  // filled buffers in reading order
+        size_t in_flight;          // number of buffers currently being filled
+        size_t next_read;          // offset of the next buffer to fill
+        size_t generation;         // incremented on every seek to drop stale buffers
+        bool stop;
+
+        inline size_t view_size() const { return end - begin; }
+
+        // reads from the file at the given offset (relative to begin) without using the shared state
+        inline size_t read_at(uchar_type* outp, size_t const offset, size_t const num) {
+            size_t num_read = 0;
+
+            #ifdef IOPP_POSIX
+            while(num_read < num) {
+                auto const n = ::pread(fd, outp + num_read, num - num_read, begin + offset + num_read);
+                if(n > 0) [[likely]] {
+                    num_read += n;
+                } else if(n < 0 && errno == EINTR) {
+                    continue; // interrupted, try again
+                } else {
+                    break; // EOF or error, maybe throw?
+                }
+            }
+            #else
+            fstream.seekg(begin + offset, std::ios::beg);
+            fstream.read((char*)outp, num);
+            num_read = fstream.gcount();
+            fstream.clear();
+            #endif
+
+            return num_read;
+        }
+
+        void run() {
+            std::unique_lock lock(mutex);
+            while(true) {
+                cv.wait(lock, [&](){ return stop || (!free.empty() && next_read < view_size()); });
+                if(stop) break;
+
+                // claim a free buffer and the next range to read
+                size_t const b = free.back();
+                free.pop_back();
+
+                size_t const offset = next_read;
+                size_t const num = std::min(bufsize, view_size() - offset);
+                size_t const gen = generation;
+                next_read += num;
+                ++in_flight;
+
+                // read without holding the lock
+                lock.unlock();
+                size_t const num_read = read_at(buffers[b].data.get(), offset, num);
+                lock.lock();
+
+                --in_flight;
+                if(gen == generation && num_read > 0) {
+                    buffers[b].offset = offset;
+                    buffers[b].size = num_read;
+                    ready.push_back(b);
+
+                    if(num_read < num) {
+                        // the file ended prematurely, don't attempt to read further
+                        next_read = view_size();
+                    }
+                } else {
+                    // the stream has seeked in the meantime or nothing could be read, drop the buffer
+                    free.push_back(b);
+                    if(gen == generation) next_read = view_size();
+                }
+                cv.notify_all();
+            }
+        }
+    };
+
+    std::unique_ptr<Shared> shared_;
+    std::thread worker_;
+
+    size_t current_; // index of the buffer currently being read from, or SIZE_MAX
+    size_t foffs_;   // offset in file
+
+    inline void release_current() {
+        if(current_ != SIZE_MAX) {
+            shared_->free.push_back(current_);
+            current_ = SIZE_MAX;
+        }
+    }
+
+    inline size_t fpos() const {
+        return foffs_ + (gptr() - eback());
+    }
+
+    inline size_t bufcount() const {
+        return egptr() - eback();
+    }
+
+    // std::streambuf like internal interface, see FileInputStream
+    bool eof_;
+    uchar_type* eback_;
+    uchar_type* gptr_;
+    uchar_type* egptr_;
+    size_t gcount_;
+
+    inline uchar_type* eback() const { return eback_; }
+    inline uchar_type* gptr() const { return gptr_; }
+    inline uchar_type* egptr() const { return egptr_; }
+
+    inline void setg(uchar_type* gbeg, uchar_type* gcurr, uchar_type* gend) {
+        eback_ = gbeg;
+        gptr_ = gcurr;
+        egptr_ = gend;
+    }
+
+    inline int underflow() {
+        foffs_ += bufcount();
+        setg(nullptr, nullptr, nullptr);
+
+        if(!shared_) return std::char_traits<char_type>::eof();
+
+        {
+            std::unique_lock lock(shared_->mutex);
+            release_current();
+            shared_->cv.notify_all();
+
+            // wait until the next buffer is ready or no more data is coming
+            shared_->cv.wait(lock, [&](){
+                return !shared_->ready.empty() || (shared_->in_flight == 0 && shared_->next_read >= shared_->view_size());
+            });
+
+            if(shared_->ready.empty()) {
+                return std::char_traits<char_type>::eof();
+            }
+
+            current_ = shared_->ready.front();
+            shared_->ready.pop_front();
+        }
+
+        auto& buf = shared_->buffers[current_];
+        foffs_ = buf.offset;
+        setg(buf.data.get(), buf.data.get(), buf.data.get() + buf.size);
+        return *(buf.data.get());
+    }
+
+    inline pos_type seekoff(off_type off, std::ios_base::seekdir dir) {
+        if(!shared_) return 0;
+
+        // determine target position
+        size_t new_foffs;
+        switch(dir) {
+            case std::ios::beg:
+                new_foffs = off;
+                break;
+
+            case std::ios::cur:
+                new_foffs = fpos() + off;
+                break;
+
+            case std::ios::end:
+                new_foffs = shared_->view_size() + off;
+                break;
+
+            default:
+                new_foffs = fpos(); // nb: not a valid direction, stay at the current position
+                break;
+        }
+
+        {
+            // drop all buffers read ahead; buffers in flight will be dropped by the worker
+            std::unique_lock lock(shared_->mutex);
+            ++shared_->generation;
+            release_current();
+            while(!shared_->ready.empty()) {
+                shared_->free.push_back(shared_->ready.front());
+                shared_->ready.pop_front();
+            }
+            shared_->next_read = new_foffs;
+            shared_->cv.notify_all();
+        }
+
+        foffs_ = new_foffs;
+        setg(nullptr, nullptr, nullptr);
+        gcount_ = 0;
+        eof_ = false;
+        return fpos();
+    }
+
+    inline void shutdown() {
+        if(worker_.joinable()) {
+            {
+                std::unique_lock lock(shared_->mutex);
+                shared_->stop = true;
+                shared_->cv.notify_all();
+            }
+            worker_.join();
+        }
+
+        #ifdef IOPP_POSIX
+        if(shared_ && shared_->fd >= 0) {
+            ::close(shared_->fd);
+            shared_->fd = -1;
+        }
+        #endif
+
+        shared_.reset();
+    }
+
+public:
+    inline AsyncFileInputStream() : current_(SIZE_MAX), foffs_(0), eof_(true), gcount_(0) {
+        setg(nullptr, nullptr, nullptr);
+    }
+
+    /**
+     * \brief Constructs a file input stream with asynchronous read-ahead for the specified file
+     * 
+     * The background thread immediately starts filling the buffers.
+     * 
+     * \param path the path to the file to read
+     * \param begin the position of the first byte to read; this will be considered the beginning of the file, even if the file has prior data
+     * \param end the position of the last byte to read; the stream will report EOF once this position is reached, even if the file is larger
+     * \param bufsize the size of each read buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize )
+     * \param num_buffers the number of buffers, which limits how far the background thread reads ahead
+     */
+    inline AsyncFileInputStream(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const bufsize = BUFSIZE_AUTO, size_t const num_buffers = 4)
+        : current_(SIZE_MAX), foffs_(0), eof_(false), gcount_(0)
+    {
+        setg(nullptr, nullptr, nullptr);
+
+        if(!std::filesystem::exists(path)) {
+            throw std::logic_error("file does not exist: " + path.string());
+        }
+
+        shared_ = std::make_unique<Shared>();
+        shared_->end = std::min(end, std::filesystem::file_size(path));
+        shared_->begin = std::min(begin, shared_->end);
+
+        #ifdef IOPP_POSIX
+        shared_->fd = open(path.c_str(), O_RDONLY);
+        posix_fadvise(shared_->fd, 0, 0, POSIX_FADV_SEQUENTIAL); // we expect sequential data access since this is a stream
+        shared_->bufsize = resolve_bufsize(bufsize, shared_->fd, shared_->view_size());
+        #else
+        shared_->fstream = std::ifstream(path, std::ios::in | std::ios::binary);
+        shared_->bufsize = resolve_bufsize(bufsize, -1, shared_->view_size());
+        #endif
+
+        // nb: we need at least two buffers, one for reading and one for filling
+        shared_->buffers.resize(std::max(num_buffers, size_t(2)));
+        for(size_t i = 0; i < shared_->buffers.size(); i++) {
+            shared_->buffers[i].data = make_stream_buffer(shared_->bufsize);
+            shared_->free.push_back(i);
+        }
+        shared_->in_flight = 0;
+        shared_->next_read = 0;
+        shared_->generation = 0;
+        shared_->stop = false;
+
+        worker_ = std::thread([s = shared_.get()](){ s->run(); });
+    }
+
+    inline ~AsyncFileInputStream() {
+        shutdown();
+    }
+
+    AsyncFileInputStream(AsyncFileInputStream const&) = delete;
+    AsyncFileInputStream& operator=(AsyncFileInputStream const&) = delete;
+
+    inline AsyncFileInputStream(AsyncFileInputStream&& other) : AsyncFileInputStream() {
+        *this = std::move(other);
+    }
+
+    inline AsyncFileInputStream& operator=(AsyncFileInputStream&& other) {
+        shutdown();
+
+        shared_ = std::move(other.shared_);
+        worker_ = std::move(other.worker_);
+        current_ = other.current_;
+        foffs_ = other.foffs_;
+        eof_ = other.eof_;
+        gcount_ = other.gcount_;
+        setg(other.eback(), other.gptr(), other.egptr());
+
+        other.current_ = SIZE_MAX;
+        other.eof_ = true;
+        other.setg(nullptr, nullptr, nullptr);
+        return *this;
+    }
+
+    /**
+     * \brief Reads a single character
+     * 
+     * \return the read character, or \c std::char_traits<char>::eof() in case EOF has been reached
+     */
+    inline int_type get() {
+        if(gptr_ < egptr_) {
+            gcount_ = 1;
+            return *gptr_++;
+        } else {
+            const auto x = underflow();
+            if(x != std::char_traits<char_type>::eof()) {
+                // all good
+                eof_ = false;
+                gcount_ = 1;
+                return *gptr_++;
+            } else {
+                // EOF
+                eof_ = true;
+                gcount_ = 0;
+                return x;
+            }
+        }
+    }
+
+    /**
+     * \brief Reads multiple characters
+     * 
+     * The number of characters successfully read can be retrieved via \ref gcount .
+     * 
+     * \param outp the output buffer
+     * \param num the number of characters to read
+     * \return a reference to this stream
+     */
+    inline AsyncFileInputStream& read(char_type* outp, const size_t num) {
+        size_t read = 0;
+        while(read < num && !eof_) {
+            // read however much is left to read in buffer
+            size_t const n = std::min(num - read, size_t(egptr_ - gptr_));
+            if(n) {
+                std::memcpy(outp + read, gptr_, n);
+                gptr_ += n;
+                read += n;
+            }
+
+            // underflow
+            if(read < num) {
+                eof_ = (underflow() == std::char_traits<char_type>::eof());
+            }
+        }
+
+        gcount_ = read;
+        return *this;
+    }
+
+    /**
+     * \brief Tests whether the stream is \em good
+     * 
+     * This is the case unless EOF has been reached after the last reading operation
+     * 
+     * \return true if there is still data available on the stream
+     * \return false if EOF has been reached
+     */
+    inline bool good() const { return !eof_; }
+
+    /**
+     * \brief Equivalent to calling \ref good .
+     */
+    explicit inline operator bool() const { return good(); }
+
+    /**
+     * \brief Reports the number of successfully read characters during the last \ref get or \ref read operation
+     * 
+     * \return size_t the number of read characters
+     */
+    inline size_t gcount() const { return gcount_; }
+
+    /**
+     * \brief Reports the next reading position in the stream
+     * 
+     * \return pos_type the next reading position in the stream
+     */
+    inline pos_type tellg() const {
+        return fpos();
+    }
+
+    /**
+     * \brief Seeks a stream position
+     * 
+     * Any buffers read ahead are discarded and the background thread starts reading from the new position.
+     * 
+     * \param off the position offset to seek
+     * \param dir determines that the offset is applied to the beginning, current position ( \ref tellg ) or the end of the stream, respectively
+     * \return AsyncFileInputStream& a reference to this stream
+     */
+    inline AsyncFileInputStream& seekg(off_type off, std::ios_base::seekdir dir) {
+        seekoff(off, dir);
+        return *this;
+    }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator over the file starting at the current stream position
+     * 
+     * \return an input iterator starting at the current stream position
+     */
+    inline auto begin() { return StreamInputIterator<AsyncFileInputStream>(*this); }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator marking the end of the file
+     * 
+     * \return an input iterator marking the end of the file
+     */
+    inline auto end() { return StreamInputIterator<AsyncFileInputStream>::end(*this); }
+};
+
+}
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * async_file_output_stream.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_ASYNC_FILE_OUTPUT_STREAM_HPP
+#define _IOPP_ASYNC_FILE_OUTPUT_STREAM_HPP
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "buffer_size.hpp"
+#include "os/posix.hpp"
+#include "util/buffer_pool.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fstream>
+#endif
+
+namespace iopp {
+
+/**
+ * \brief \ref iopp::STLOutputStreamLike "Standard output stream like" file output stream with asynchronous write-behind
+ * 
+ * This stream behaves like \ref FileOutputStream , but full buffers are written to the file by a background thread.
+ * While the background thread is writing, the producer can continue filling another buffer.
+ * 
+ * Errors that occur while writing in the background are reported by throwing a `std::system_error` on the next operation that hands over a buffer, i.e., when a buffer runs full or on \ref flush .
+ * The destructor waits for all pending buffers to be written, but cannot report errors; call \ref flush before destruction to be sure that everything has been written successfully.
+ * 
+ * This output stream does \em not support seek operations.
+ * A default-constructed or moved-from stream discards all written characters.
+ */
+class AsyncFileOutputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+private:
+    using uchar_type = unsigned char;
+
+    struct Buffer {
+        AlignedBuffer data;
+        size_t size; // number of bytes to write
+    };
+
+    // state shared with the background thread
+    // this is kept on the heap so that the stream can be moved while the thread is running
+    struct Shared {
+        #ifdef IOPP_POSIX
+        int fd;
+        #else
+        std::ofstream fstream;
+        #endif
+
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        std::vector<Buffer> buffers;
+        std::vector<size_t> free;   // buffers available to the producer
+        std::deque<size_t> pending; // buffers to be written in order
+        size_t in_flight;           // number of buffers currently being written
+        int error;                  // the first error that occurred since it was last reported, or zero
+        bool stop;
+
+        // writes the buffer to the file without using the shared state, returning an error code
+        inline int write(Buffer const& buf) {
+            #ifdef IOPP_POSIX
+            if(fd < 0) return EBADF;
+
+            size_t num_written = 0;
+            while(num_written < buf.size) {
+                ssize_t const w = ::write(fd, buf.data.get() + num_written, buf.size - num_written);
+                if(w > 0) [[likely]] {
+                    num_written += w;
+                } else if(w < 0 && errno == EINTR) {
+                    continue; // interrupted, try again
+                } else {
+                    return w < 0 ? errno : EIO;
+                }
+            }
+            return 0;
+            #else
+            fstream.write((char const*)buf.data.get(), buf.size);
+            return fstream.good() ? 0 : EIO;
+            #endif
+        }
+
+        void run() {
+            std::unique_lock lock(mutex);
+            while(true) {
+                cv.wait(lock, [&](){ return stop || !pending.empty(); });
+                if(pending.empty()) break; // nb: only stop once everything has been written
+
+                size_t const b = pending.front();
+                pending.pop_front();
+                ++in_flight;
+
+                // write without holding the lock
+                lock.unlock();
+                int const err = write(buffers[b]);
+                lock.lock();
+
+                --in_flight;
+                if(err && !error) error = err;
+                free.push_back(b);
+                cv.notify_all();
+            }
+        }
+    };
+
+    std::unique_ptr<Shared> shared_;
+    std::thread worker_;
+
+    size_t current_; // index of the buffer currently being filled
+    size_t bufsize_;
+    size_t foffs_;   // offset in file
+
+    inline size_t fpos() const {
+        return foffs_ + (pptr() - pbase());
+    }
+
+    inline size_t bufcount() const {
+        return pptr() - pbase();
+    }
+
+    // std::streambuf like internal interface, see FileOutputStream
+    uchar_type* pbase_;
+    uchar_type* pptr_;
+    uchar_type* epptr_;
+
+    inline uchar_type* pbase() const { return pbase_; }
+    inline uchar_type* pptr() const { return pptr_; }
+    inline uchar_type* epptr() const { return epptr_; }
+
+    inline void setp(uchar_type* pbeg, uchar_type* pend) {
+        pbase_ = pbeg;
+        pptr_ = pbeg;
+        epptr_ = pend;
+    }
+
+    // throws the pending background error, if any; the lock must be held
+    inline void report_error() {
+        int const err = shared_->error;
+        if(err) {
+            shared_->error = 0;
+            throw std::system_error(err, std::generic_category(), "asynchronous write failed");
+        }
+    }
+
+    // hands the current buffer over to the background thread and acquires a free one
+    inline int sync() {
+        if(!shared_) return 0;
+
+        size_t const wnum = bufcount();
+        {
+            std::unique_lock lock(shared_->mutex);
+            if(wnum) {
+                shared_->buffers[current_].size = wnum;
+                shared_->pending.push_back(current_);
+                shared_->cv.notify_all();
+
+                // wait for a free buffer
+                shared_->cv.wait(lock, [&](){ return !shared_->free.empty(); });
+                current_ = shared_->free.back();
+                shared_->free.pop_back();
+            }
+            foffs_ += wnum;
+
+            auto* buf = shared_->buffers[current_].data.get();
+            setp(buf, buf + bufsize_);
+
+            report_error();
+        }
+        return 0;
+    }
+
+    inline void shutdown() {
+        if(worker_.joinable()) {
+            // hand over the final buffer and let the background thread drain all pending buffers
+            std::unique_lock lock(shared_->mutex);
+            size_t const wnum = bufcount();
+            if(wnum) {
+                shared_->buffers[current_].size = wnum;
+                shared_->pending.push_back(current_);
+                foffs_ += wnum;
+            }
+            setp(nullptr, nullptr);
+
+            shared_->stop = true;
+            shared_->cv.notify_all();
+            lock.unlock();
+            worker_.join();
+        }
+
+        #ifdef IOPP_POSIX
+        if(shared_ && shared_->fd >= 0) {
+            ::close(shared_->fd);
+            shared_->fd = -1;
+        }
+        #endif
+
+        shared_.reset();
+    }
+ 
+public:
+    inline AsyncFileOutputStream() : current_(0), bufsize_(0), foffs_(0) {
+        setp(nullptr, nullptr);
+    }
+
+    /**
+     * \brief Constructs a file output stream with asynchronous write-behind for the specified file
+     * 
+     * If the file already exists, it will be overwritten.
+     * 
+     * \param path the path to the file to write
+     * \param bufsize the size of each write buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize )
+     * \param num_buffers the number of buffers, which limits how many buffers may be pending to be written
+     */
+    inline AsyncFileOutputStream(std::filesystem::path const& path, size_t const bufsize = BUFSIZE_AUTO, size_t const num_buffers = 4) : bufsize_(bufsize), foffs_(0) {
+        shared_ = std::make_unique<Shared>();
+
+        #ifdef IOPP_POSIX
+        const auto mask = umask(0);
+        umask(mask); // needed to restore as per POSIX documentation
+        shared_->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 & ~mask);
+        posix_fadvise(shared_->fd, 0, 0, POSIX_FADV_SEQUENTIAL); // we expect sequential data access since this is a stream
+        bufsize_ = resolve_bufsize(bufsize_, shared_->fd);
+        #else
+        shared_->fstream = std::ofstream(path, std::ios::out | std::ios::binary);
+        bufsize_ = resolve_bufsize(bufsize_);
+        #endif
+
+        // nb: we need at least two buffers, one for filling and one for writing
+        shared_->buffers.resize(std::max(num_buffers, size_t(2)));
+        for(size_t i = 0; i < shared_->buffers.size(); i++) {
+            shared_->buffers[i].data = make_stream_buffer(bufsize_);
+            shared_->free.push_back(i);
+        }
+        shared_->in_flight = 0;
+        shared_->error = 0;
+        shared_->stop = false;
+
+        current_ = shared_->free.back();
+        shared_->free.pop_back();
+
+        auto* buf = shared_->buffers[current_].data.get();
+        setp(buf, buf + bufsize_);
+
+        worker_ = std::thread([s = shared_.get()](){ s->run(); });
+    }
+
+    /**
+     * \brief Waits until all buffered data has been written to the file
+     */
+    inline ~AsyncFileOutputStream() {
+        shutdown();
+    }
+
+    AsyncFileOutputStream(AsyncFileOutputStream const&) = delete;
+    AsyncFileOutputStream& operator=(AsyncFileOutputStream const&) = delete;
+
+    inline AsyncFileOutputStream(AsyncFileOutputStream&& other) : AsyncFileOutputStream() {
+        *this = std::move(other);
+    }
+
+    inline AsyncFileOutputStream& operator=(AsyncFileOutputStream&& other) {
+        shutdown();
+
+        shared_ = std::move(other.shared_);
+        worker_ = std::move(other.worker_);
+        current_ = other.current_;
+        bufsize_ = other.bufsize_;
+        foffs_ = other.foffs_;
+
+        pbase_ = other.pbase_;
+        pptr_ = other.pptr_;
+        epptr_ = other.epptr_;
+
+        other.setp(nullptr, nullptr);
+        return *this;
+    }
+
+    /**
+     * \brief Writes a single character
+     * 
+     * \return a reference to this stream
+     */
+    inline AsyncFileOutputStream& put(const char_type c) {
+        if(pptr_ >= epptr_) {
+            if(!shared_) return *this; // nb: there is no file, discard the character
+
+            // hand over buffer
+            sync();
+        }
+
+        *pptr_++ = c;
+        return *this;
+    }
+
+    /**
+     * \brief Writes multiple characters
+     * 
+     * \param inp the input characters
+     * \param num the number of characters to write
+     * \return a reference to this stream
+     */
+    inline AsyncFileOutputStream& write(char_type const* inp, const size_t num) {
+        size_t written = 0;
+        while(written < num) {
+            size_t const n = std::min(num - written, size_t(epptr_ - pptr_));
+            if(n) {
+                std::memcpy(pptr_, inp + written, n);
+                pptr_ += n;
+                written += n;
+            }
+
+            if(written < num) {
+                if(!shared_) break; // nb: there is no file, discard the characters
+                sync(); // hand over buffer when necessary
+            }
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Hands the current buffer over to the background thread and waits until all pending buffers have been written to the output file
+     * 
+     * In case an error occurred while writing in the background, a `std::system_error` is thrown.
+     * 
+     * \return a reference to this stream
+     */
+    inline AsyncFileOutputStream& flush() {
+        sync();
+        if(shared_) {
+            std::unique_lock lock(shared_->mutex);
+            shared_->cv.wait(lock, [&](){ return shared_->pending.empty() && shared_->in_flight == 0; });
+            report_error();
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Reports the next write position in the file
+     * 
+     * \return the next write position in the file
+     */
+    inline pos_type tellp() const {
+        return fpos();
+    }
+};
+
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include "stream_output_iterator.hpp"
 
 #include "util/bit_packer.hpp"
+#include "util/bit_reader.hpp"
 #include "util/bit_unpacker.hpp"
 #include "util/char_packer.hpp"
 #include "util/char_unpacker.hpp"
@@ -51,13 +52,15 @@ namespace iopp {
  * Note that there is no indication as to when the input ends;
  * it is the responsibility of the programmer to stop reading before the end of the stream.
  * 
+ * \tparam Word the pack word type, \ref PackWord by default
  * \tparam InputStream the input stream type
  * \param in the input stream
  * \return a bit source reading from the input stream
  */
-template<STLInputStreamLike InputStream>
+template<PackWordType Word = PackWord, STLInputStreamLike InputStream>
 auto bitwise_input_from(InputStream& in) {
-    return BitUnpacker(CharPacker(StreamInputIterator(in), {}));
+    using Input = decltype(StreamInputIterator(in));
+    return BitUnpacker(CharPacker<Input, Word>(StreamInputIterator(in), {}));
 }
 
 /**
@@ -70,14 +73,15 @@ auto bitwise_input_from(InputStream& in) {
  * 
  * If a finalizer is available at the end of the input, it will be used to deliver proper end-of-file information.
  * 
- * \tparam InputStream the input stream type
+ * \tparam Word the pack word type, \ref PackWord by default
+ * \tparam Input the input iterator type
  * \param begin the beginning of the input
  * \param end the end of the input
  * \return a bit source reading from the input
  */
-template<InputIterator<char> Input>
+template<PackWordType Word = PackWord, InputIterator<char> Input>
 auto bitwise_input_from(Input begin, Input end) {
-    return BitUnpacker(CharPacker(begin, end), {});
+    return BitUnpacker(CharPacker<Input, Word>(begin, end), {});
 }
 
 /**
@@ -88,14 +92,15 @@ auto bitwise_input_from(Input begin, Input end) {
  * BitPacker(CharUnpacker(out))
  * \endcode
  * 
+ * \tparam Word the pack word type, \ref PackWord by default
  * \tparam Out the output iterator type
  * \param out the output iterator
  * \param finalize whether or not to append a finalizer to the stream after destroying the bit sink
  * \return a bit sink writing to the output iterator
  */
-template<std::output_iterator<char> Out>
+template<PackWordType Word = PackWord, std::output_iterator<char> Out>
 auto bitwise_output_to(Out out, bool const finalize = true) {
-    return BitPacker(CharUnpacker(out), finalize);
+    return BitPacker(CharUnpacker<Out, Word>(out), finalize);
 }
 
 /**
@@ -106,14 +111,16 @@ auto bitwise_output_to(Out out, bool const finalize = true) {
  * BitPacker(CharUnpacker(StreamOutputIterator(out)))
  * \endcode
  * 
+ * \tparam Word the pack word type, \ref PackWord by default
  * \tparam OutputStream the output stream type
  * \param out the output stream
  * \param finalize whether or not to append a finalizer to the stream after destroying the bit sink
  * \return a bit sink writing to the output stream
  */
-template<STLOutputStreamLike OutputStream>
+template<PackWordType Word = PackWord, STLOutputStreamLike OutputStream>
 auto bitwise_output_to(OutputStream& out, bool const finalize = true) {
-    return BitPacker(CharUnpacker(StreamOutputIterator(out)), finalize);
+    using Output = decltype(StreamOutputIterator(out));
+    return BitPacker(CharUnpacker<Output, Word>(StreamOutputIterator(out)), finalize);
 }
 
 }
@@ -0,0 +1,168 @@
+/**
+ * buffer_size.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_BUFFER_SIZE_HPP
+#define _IOPP_BUFFER_SIZE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "os/posix.hpp"
+
+#ifdef IOPP_POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace iopp {
+
+/**
+ * \brief Buffer size value that lets streams choose their buffer size automatically
+ * 
+ * This is the default buffer size for all file streams.
+ * It resolves to the \ref set_default_bufsize "process-wide default" if one is set, and otherwise to the result of \ref auto_bufsize .
+ */
+constexpr size_t BUFSIZE_AUTO = 0;
+
+/**
+ * \brief The smallest buffer size chosen by \ref auto_bufsize
+ */
+constexpr size_t BUFSIZE_AUTO_MIN = 4 * 1024;
+
+/**
+ * \brief The buffer size preferred by \ref auto_bufsize for large regular files
+ */
+constexpr size_t BUFSIZE_AUTO_PREFERRED = 256 * 1024;
+
+/**
+ * \brief The largest buffer size chosen by \ref auto_bufsize
+ */
+constexpr size_t BUFSIZE_AUTO_MAX = 4 * 1024 * 1024;
+
+namespace detail {
+
+// parses a size with an optional binary suffix (K, M or G), returns zero if the string is invalid
+inline size_t parse_bufsize(char const* s) {
+    if(!s || !*s) return 0;
+
+    char* end;
+    size_t const x = std::strtoull(s, &end, 10);
+    switch(*end) {
+        case 0: return x;
+        case 'k': case 'K': return x << 10;
+        case 'm': case 'M': return x << 20;
+        case 'g': case 'G': return x << 30;
+        default: return 0;
+    }
+}
+
+inline std::atomic<size_t>& default_bufsize() {
+    static std::atomic<size_t> bufsize = parse_bufsize(std::getenv("IOPP_BUFSIZE"));
+    return bufsize;
+}
+
+}
+
+/**
+ * \brief Sets the process-wide default buffer size
+ * 
+ * Streams constructed with \ref BUFSIZE_AUTO after this call will use the given buffer size.
+ * Passing \ref BUFSIZE_AUTO restores automatic choice.
+ * 
+ * Initially, the default is taken from the `IOPP_BUFSIZE` environment variable, which may contain a number of bytes optionally followed by `K`, `M` or `G` (e.g., `1M`).
+ * 
+ * \param bufsize the default buffer size
+ */
+inline void set_default_bufsize(size_t const bufsize) {
+    detail::default_bufsize().store(bufsize, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Reports the process-wide default buffer size
+ * 
+ * \return the default buffer size, or \ref BUFSIZE_AUTO if it is chosen automatically
+ */
+inline size_t default_bufsize() {
+    return detail::default_bufsize().load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Chooses a buffer size for streaming the given file
+ * 
+ * For pipes and sockets, the pipe capacity is used if it can be determined, and 64 KiB otherwise.
+ * For other files, the buffer size is the larger of \ref BUFSIZE_AUTO_PREFERRED and the file system's preferred I/O block size (`st_blksize`), but not larger than \ref BUFSIZE_AUTO_MAX .
+ * If the amount of data to stream is known to be smaller, the buffer size is reduced to fit it, rounded up to the block size.
+ * 
+ * \param fd the file descriptor of the file, or -1 if it is not available (always ignored on non-POSIX systems)
+ * \param size the number of bytes that are going to be streamed, or \c SIZE_MAX if unknown
+ * \return the chosen buffer size
+ */
+inline size_t auto_bufsize(int const fd = -1, size_t const size = SIZE_MAX) {
+    size_t blksize = BUFSIZE_AUTO_MIN;
+
+    #ifdef IOPP_POSIX
+    struct stat st;
+    if(fd >= 0 && fstat(fd, &st) == 0) {
+        if(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode)) {
+            #ifdef F_GETPIPE_SZ
+            int const pipe_size = fcntl(fd, F_GETPIPE_SZ);
+            if(pipe_size > 0) return pipe_size;
+            #endif
+            return 64 * 1024;
+        }
+        if(st.st_blksize > 0) blksize = st.st_blksize;
+    }
+    #endif
+
+    size_t bufsize = std::min(std::max(BUFSIZE_AUTO_PREFERRED, blksize), BUFSIZE_AUTO_MAX);
+    if(size < bufsize) {
+        bufsize = std::max(BUFSIZE_AUTO_MIN, ((size + blksize - 1) / blksize) * blksize);
+    }
+    return bufsize;
+}
+
+/**
+ * \brief Resolves the buffer size requested for a stream
+ * 
+ * \param bufsize the requested buffer size, or \ref BUFSIZE_AUTO
+ * \param fd the file descriptor of the file, or -1 if it is not available
+ * \param size the number of bytes that are going to be streamed, or \c SIZE_MAX if unknown
+ * \return the requested buffer size if it is not \ref BUFSIZE_AUTO ; otherwise, the \ref default_bufsize "process-wide default" if it is set, or else the result of \ref auto_bufsize
+ */
+inline size_t resolve_bufsize(size_t const bufsize, int const fd = -1, size_t const size = SIZE_MAX) {
+    if(bufsize != BUFSIZE_AUTO) return bufsize;
+
+    size_t const def = default_bufsize();
+    return (def != BUFSIZE_AUTO) ? def : auto_bufsize(fd, size);
+}
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * cache_mode.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _IOPP_CACHE_MODE_HPP
+#define _IOPP_CACHE_MODE_HPP
+
+#include <algorithm>
+#include <cstddef>
+
+#include "os/posix.hpp"
+
+#ifdef IOPP_POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace iopp {
+
+/**
+ * \brief Determines how file streams interact with the operating system's page cache
+ * 
+ * This only has an effect on POSIX systems.
+ */
+enum class CacheMode {
+    /**
+     * \brief File data is cached by the operating system as usual
+     */
+    normal,
+
+    /**
+     * \brief File data that has been read or written is evicted from the cache as the stream advances
+     * 
+     * This uses `posix_fadvise` with `POSIX_FADV_DONTNEED` on ranges that have already been consumed.
+     * For output, writeback of written ranges is initiated early so that they can be evicted.
+     */
+    drop_behind,
+
+    /**
+     * \brief File data bypasses the cache entirely using direct I/O (`O_DIRECT`)
+     * 
+     * Buffers are aligned to the file system's direct I/O alignment, and reads and writes are done in aligned blocks internally.
+     * If the file system does not support direct I/O, \ref drop_behind is used instead.
+     */
+    direct,
+};
+
+#ifdef IOPP_POSIX
+/**
+ * \brief Determines the alignment required for direct I/O on the given file
+ * 
+ * On Linux, this is queried via `statx`, if supported.
+ * Otherwise, the file system's preferred block size is used, but at least 4096 bytes.
+ * 
+ * \param fd the file descriptor
+ * \return the alignment required for memory buffers, file offsets and transfer sizes
+ */
+inline size_t direct_io_alignment(int const fd) {
+    size_t align = 4096;
+
+    #ifdef STATX_DIOALIGN
+    struct statx stx;
+    if(statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align) {
+        align = std::max(stx.stx_dio_offset_align, stx.stx_dio_mem_align);
+        return align;
+    }
+    #endif
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && (size_t)st.st_blksize > align) {
+        align = st.st_blksize;
+    }
+    return align;
+}
+#endif
+
+}
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ * codes.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_CODES_HPP
+#define _IOPP_CODES_HPP
+
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+
+#include "concepts.hpp"
+#include "util/bits.hpp"
+
+namespace iopp {
+
+/**
+ * \brief Writes a number in unary code to a \ref iopp::BitSink "BitSink"
+ * 
+ * The code consists of `n` 0-bits followed by a 1-bit.
+ * If the sink is a \ref iopp::UnaryBitSink "UnaryBitSink", its `write_unary` is used, otherwise the 0-bits are written in chunks of up to 64 bits.
+ * 
+ * \param sink the bit sink
+ * \param n the number to encode
+ */
+template<BitSink Sink>
+inline void write_unary(Sink& sink, uintmax_t n) {
+    if constexpr(UnaryBitSink<Sink>) {
+        sink.write_unary(n);
+    } else {
+        while(n >= 64) {
+            sink.write(uintmax_t(0), 64);
+            n -= 64;
+        }
+        sink.write(set_bit(n), n + 1);
+    }
+}
+
+/**
+ * \brief Reads a number in unary code from a \ref iopp::BitSource "BitSource"
+ * 
+ * If the source is a \ref iopp::UnaryBitSource "UnaryBitSource", its `read_unary` is used, which counts the 0-bits in a single step per word.
+ * Otherwise, the code is read bit by bit.
+ * 
+ * \param src the bit source
+ * \return the decoded number
+ */
+template<BitSource Source>
+inline uintmax_t read_unary(Source& src) {
+    if constexpr(UnaryBitSource<Source>) {
+        return src.read_unary();
+    } else {
+        uintmax_t n = 0;
+        while(!src.read()) ++n;
+        return n;
+    }
+}
+
+/**
+ * \brief Writes a positive number in Elias-gamma code to a \ref iopp::BitSink "BitSink"
+ * 
+ * The code consists of the number of bits following the most significant 1-bit of `x` in unary code, followed by these bits.
+ * It requires `2 * floor(log2(x)) + 1` bits.
+ * 
+ * \param sink the bit sink
+ * \param x the number to encode, must be positive
+ */
+template<BitSink Sink>
+inline void write_gamma(Sink& sink, uintmax_t const x) {
+    assert(x > 0);
+    size_t const n = std::bit_width(x) - 1;
+    write_unary(sink, n);
+    if(n) sink.write(x, n);
+}
+
+/**
+ * \brief Reads a number in Elias-gamma code from a \ref iopp::BitSource "BitSource"
+ * 
+ * \param src the bit source
+ * \return the decoded number
+ */
+template<BitSource Source>
+inline uintmax_t read_gamma(Source& src) {
+    size_t const n = read_unary(src);
+    return n ? (set_bit(n) | src.read(n)) : 1;
+}
+
+/**
+ * \brief Writes a positive number in Elias-delta code to a \ref iopp::BitSink "BitSink"
+ * 
+ * The code consists of the bit width of `x` in Elias-gamma code, followed by the bits following the most significant 1-bit of `x`.
+ * For large numbers, it is shorter than the Elias-gamma code.
+ * 
+ * \param sink the bit sink
+ * \param x the number to encode, must be positive
+ */
+template<BitSink Sink>
+inline void write_delta(Sink& sink, uintmax_t const x) {
+    assert(x > 0);
+    size_t const w = std::bit_width(x);
+    write_gamma(sink, w);
+    if(w > 1) sink.write(x, w - 1);
+}
+
+/**
+ * \brief Reads a number in Elias-delta code from a \ref iopp::BitSource "BitSource"
+ * 
+ * \param src the bit source
+ * \return the decoded number
+ */
+template<BitSource Source>
+inline uintmax_t read_delta(Source& src) {
+    size_t const w = read_gamma(src);
+    return (w > 1) ? (set_bit(w - 1) | src.read(w - 1)) : 1;
+}
+
+/**
+ * \brief Writes a number in Golomb-Rice code to a \ref iopp::BitSink "BitSink"
+ * 
+ * The code consists of the quotient `x / 2^k` in unary code, followed by the `k` low bits of `x`.
+ * It is well suited for geometrically distributed numbers, e.g., gaps between sorted integers.
+ * 
+ * \param sink the bit sink
+ * \param x the number to encode
+ * \param k the Rice parameter, must be in `[0, 63]`
+ */
+template<BitSink Sink>
+inline void write_rice(Sink& sink, uintmax_t const x, size_t const k) {
+    assert(k < 64);
+    write_unary(sink, x >> k);
+    if(k) sink.write(x, k);
+}
+
+/**
+ * \brief Reads a number in Golomb-Rice code from a \ref iopp::BitSource "BitSource"
+ * 
+ * \param src the bit source
+ * \param k the Rice parameter used for encoding
+ * \return the decoded number
+ */
+template<BitSource Source>
+inline uintmax_t read_rice(Source& src, size_t const k) {
+    uintmax_t const q = read_unary(src);
+    return k ? ((q << k) | src.read(k)) : q;
+}
+
+/**
+ * \brief Writes a number in variable-byte (VByte) code to a \ref iopp::BitSink "BitSink"
+ * 
+ * The number is split into groups of seven bits, starting with the lowest.
+ * Each group is written as eight bits, where the highest bit tells whether another group follows.
+ * In byte-aligned memory, use \ref encode_vbyte instead.
+ * 
+ * \param sink the bit sink
+ * \param x the number to encode
+ */
+template<BitSink Sink>
+inline void write_vbyte(Sink& sink, uintmax_t x) {
+    while(x >= 0x80) {
+        write_bits<8>(sink, (x & 0x7F) | 0x80);
+        x >>= 7;
+    }
+    write_bits<8>(sink, x);
+}
+
+/**
+ * \brief Reads a number in variable-byte (VByte) code from a \ref iopp::BitSource "BitSource"
+ * 
+ * \param src the bit source
+ * \return the decoded number
+ */
+template<BitSource Source>
+inline uintmax_t read_vbyte(Source& src) {
+    uintmax_t x = 0;
+    size_t shift = 0;
+    while(true) {
+        uintmax_t const b = read_bits<8>(src);
+        if(shift < 64) x |= (b & 0x7F) << shift; // nb: ignore excess groups of malformed input
+        if(!(b & 0x80)) return x;
+        shift += 7;
+    }
+}
+
+/**
+ * \brief The maximum number of bytes of a variable-byte (VByte) code of a 64-bit number
+ */
+constexpr size_t VBYTE_MAX_BYTES = 10;
+
+/**
+ * \brief Encodes a number in variable-byte (VByte) code into memory
+ * 
+ * The format is the same as written by \ref write_vbyte , but each group occupies exactly one byte.
+ * 
+ * \param x the number to encode
+ * \param out the output; at most \ref VBYTE_MAX_BYTES bytes are written
+ * \return a pointer to the byte following the code
+ */
+inline char* encode_vbyte(uintmax_t x, char* out) {
+    while(x >= 0x80) {
+        *out++ = (char)((x & 0x7F) | 0x80);
+        x >>= 7;
+    }
+    *out++ = (char)x;
+    return out;
+}
+
+/**
+ * \brief Decodes a number in variable-byte (VByte) code from memory
+ * 
+ * \param in the input, which is advanced past the code
+ * \return the decoded number
+ */
+inline uintmax_t decode_vbyte(char const*& in) {
+    uintmax_t x = 0;
+    size_t shift = 0;
+    while(true) {
+        uintmax_t const b = (unsigned char)*in++;
+        if(shift < 64) x |= (b & 0x7F) << shift; // nb: ignore excess groups of malformed input
+        if(!(b & 0x80)) return x;
+        shift += 7;
+    }
+}
+
+/**
+ * \brief Encodes multiple numbers in variable-byte (VByte) code into memory
+ * 
+ * \tparam T the input integer type
+ * \param in the input array
+ * \param count the number of integers to encode
+ * \param out the output; at most `count` times \ref VBYTE_MAX_BYTES bytes are written
+ * \return a pointer to the byte following the last code
+ */
+template<std::unsigned_integral T>
+inline char* encode_vbyte_many(T const* in, size_t const count, char* out) {
+    for(size_t i = 0; i < count; i++) {
+        if(in[i] < 0x80) [[likely]] {
+            *out++ = (char)in[i];
+        } else {
+            out = encode_vbyte(in[i], out);
+        }
+    }
+    return out;
+}
+
+/**
+ * \brief Decodes multiple numbers in variable-byte (VByte) code from memory
+ * 
+ * Runs of numbers that are encoded in a single byte each, which are the most common in practice, are detected and decoded eight at a time.
+ * 
+ * \tparam T the output integer type; if a decoded number exceeds the type's width, the high bits are lost
+ * \param in the input
+ * \param end the end of the input; in case of well-formed input, no byte at or beyond this is read
+ * \param out the output array
+ * \param count the number of integers to decode
+ * \return a pointer to the byte following the last decoded code
+ */
+template<std::unsigned_integral T>
+inline char const* decode_vbyte_many(char const* in, char const* const end, T* out, size_t const count) {
+    constexpr uint64_t CONTINUATION = 0x8080808080808080ULL;
+
+    size_t i = 0;
+    while(i < count && in < end) {
+        if(count - i >= 8 && end - in >= 8) {
+            uint64_t block;
+            std::memcpy(&block, in, 8);
+            if(!(block & CONTINUATION)) {
+                // eight single-byte codes
+                for(size_t j = 0; j < 8; j++) out[i + j] = (T)(unsigned char)in[j];
+                in += 8;
+                i += 8;
+                continue;
+            }
+        }
+        out[i++] = (T)decode_vbyte(in);
+    }
+    return in;
+}
+
+}
+
+#endif
@@ -0,0 +1,469 @@
+/**
+ * compressed_stream.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_COMPRESSED_STREAM_HPP
+#define _IOPP_COMPRESSED_STREAM_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "concepts.hpp"
+#include "stream_input_iterator.hpp"
+
+namespace iopp {
+
+/**
+ * \brief Concept for decoders used by \ref DecompressingInputStream
+ * 
+ * In order to satisfy the concept, the type must be default constructible and movable, and provide
+ * * a function `decode` that decodes as much as possible from the input range `[in, in_end)` into the output range `[out, out_end)`, advancing both pointers accordingly, and throws a `std::runtime_error` if the input is corrupted, and
+ * * a function `finished` that tells whether the input decoded so far ends at the end of a frame, i.e., whether the input may end here.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept StreamDecoder =
+    std::default_initializable<T> && std::movable<T> &&
+    requires(T subject, char const*& in, char const* in_end, char*& out, char* out_end) {
+        { subject.decode(in, in_end, out, out_end) };
+    } &&
+    requires(T const subject) {
+        { subject.finished() } -> std::same_as<bool>;
+    };
+
+namespace detail {
+
+// the type of sinks passed to stream encoders
+struct EncoderSinkArchetype {
+    void operator()(char const*, size_t) const {}
+};
+
+}
+
+/**
+ * \brief Concept for encoders used by \ref CompressingOutputStream
+ * 
+ * In order to satisfy the concept, the type must be movable and provide the following function templates accepting a callable `sink(char const* data, size_t num)` that receives the encoded output:
+ * * `encode(in, num, sink)` to encode the given characters,
+ * * `flush(sink)` to emit everything encoded so far such that it can be decoded, and
+ * * `finish(sink)` to end the current frame; encoding further characters begins a new frame.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept StreamEncoder =
+    std::movable<T> &&
+    requires(T subject, char const* in, size_t num, detail::EncoderSinkArchetype sink) {
+        { subject.encode(in, num, sink) };
+        { subject.flush(sink) };
+        { subject.finish(sink) };
+    };
+
+/**
+ * \brief \ref iopp::STLInputStreamLike "Standard input stream like" adaptor that decompresses the contents of another input stream
+ * 
+ * Compressed data is read from the underlying stream in chunks and decoded into a buffer, from which characters are then read.
+ * Since this is an input stream itself, it can be passed to, e.g., \ref bitwise_input_from , \ref StreamInputIterator or \ref load_file_str .
+ * The underlying stream must outlive this stream.
+ * 
+ * If the compressed input ends in the middle of a frame, a `std::runtime_error` is thrown, as is if the decoder reports corrupted input.
+ * 
+ * This input stream does \em not support seek operations.
+ * 
+ * \tparam Decoder the \ref iopp::StreamDecoder "decoder" type, e.g., \ref ZstdDecoder or \ref Lz4Decoder
+ * \tparam InputStream the underlying input stream type
+ */
+template<StreamDecoder Decoder, STLInputStreamLike InputStream>
+class DecompressingInputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+    /**
+     * \brief The default size of the buffers for compressed and decompressed data
+     */
+    static constexpr size_t DEFAULT_BUFSIZE = 128 * 1024;
+
+private:
+    using uchar_type = unsigned char;
+
+    InputStream* in_;
+    Decoder decoder_;
+
+    size_t bufsize_;
+    std::unique_ptr<char[]> inbuf_;  // compressed data
+    std::unique_ptr<char[]> outbuf_; // decompressed data
+    char const* ipos_;
+    char const* iend_;
+    bool in_eof_;
+
+    size_t foffs_; // offset of the current buffer in the decompressed stream
+
+    bool eof_;
+    char* gptr_;
+    char* egptr_;
+    size_t gcount_;
+
+    inline int underflow() {
+        foffs_ += egptr_ - outbuf_.get();
+        gptr_ = egptr_ = outbuf_.get();
+
+        while(true) {
+            if(ipos_ == iend_ && !in_eof_) {
+                // read more compressed data
+                in_->read(inbuf_.get(), bufsize_);
+                size_t const n = in_->gcount();
+                ipos_ = inbuf_.get();
+                iend_ = ipos_ + n;
+                in_eof_ = (n == 0);
+            }
+
+            char* out = outbuf_.get();
+            decoder_.decode(ipos_, iend_, out, outbuf_.get() + bufsize_);
+            if(out > outbuf_.get()) {
+                egptr_ = out;
+                return (uchar_type)*gptr_;
+            }
+
+            if(ipos_ == iend_ && in_eof_) {
+                if(!decoder_.finished()) throw std::runtime_error("compressed input is truncated");
+                return std::char_traits<char_type>::eof();
+            }
+        }
+    }
+
+public:
+    inline DecompressingInputStream() : in_(nullptr), bufsize_(0), ipos_(nullptr), iend_(nullptr), in_eof_(true), foffs_(0), eof_(true), gptr_(nullptr), egptr_(nullptr), gcount_(0) {
+    }
+
+    /**
+     * \brief Constructs a decompressing input stream reading from the given input stream
+     * 
+     * \param in the input stream to read compressed data from
+     * \param decoder the decoder
+     * \param bufsize the size of the buffers for compressed and decompressed data, respectively
+     */
+    inline DecompressingInputStream(InputStream& in, Decoder&& decoder = Decoder(), size_t const bufsize = DEFAULT_BUFSIZE)
+        : in_(&in), decoder_(std::move(decoder)), bufsize_(std::max(bufsize, size_t(1))), in_eof_(false), foffs_(0), eof_(false), gcount_(0) {
+
+        inbuf_ = std::unique_ptr<char[]>(new char[bufsize_]);
+        outbuf_ = std::unique_ptr<char[]>(new char[bufsize_]);
+        ipos_ = iend_ = inbuf_.get();
+        gptr_ = egptr_ = outbuf_.get();
+    }
+
+    DecompressingInputStream(DecompressingInputStream const&) = delete;
+    DecompressingInputStream& operator=(DecompressingInputStream const&) = delete;
+
+    inline DecompressingInputStream(DecompressingInputStream&& other) : DecompressingInputStream() {
+        *this = std::move(other);
+    }
+
+    inline DecompressingInputStream& operator=(DecompressingInputStream&& other) {
+        in_ = std::exchange(other.in_, nullptr);
+        decoder_ = std::move(other.decoder_);
+        bufsize_ = other.bufsize_;
+        inbuf_ = std::move(other.inbuf_); // nb: this does not move the buffers in memory, so the pointers remain valid
+        outbuf_ = std::move(other.outbuf_);
+        ipos_ = std::exchange(other.ipos_, nullptr);
+        iend_ = std::exchange(other.iend_, nullptr);
+        in_eof_ = std::exchange(other.in_eof_, true);
+        foffs_ = other.foffs_;
+        eof_ = std::exchange(other.eof_, true);
+        gptr_ = std::exchange(other.gptr_, nullptr);
+        egptr_ = std::exchange(other.egptr_, nullptr);
+        gcount_ = std::exchange(other.gcount_, 0);
+        return *this;
+    }
+
+    /**
+     * \brief Reads a single character
+     * 
+     * \return the read character, or \c std::char_traits<char>::eof() in case EOF has been reached
+     */
+    inline int_type get() {
+        if(gptr_ < egptr_) [[likely]] {
+            gcount_ = 1;
+            return (uchar_type)*gptr_++;
+        }
+
+        if(in_ && underflow() != std::char_traits<char_type>::eof()) {
+            gcount_ = 1;
+            return (uchar_type)*gptr_++;
+        } else {
+            eof_ = true;
+            gcount_ = 0;
+            return std::char_traits<char_type>::eof();
+        }
+    }
+
+    /**
+     * \brief Reads multiple characters
+     * 
+     * The number of characters successfully read can be retrieved via \ref gcount .
+     * 
+     * \param outp the output buffer
+     * \param num the number of characters to read
+     * \return a reference to this stream
+     */
+    inline DecompressingInputStream& read(char_type* outp, size_t const num) {
+        size_t n = 0;
+        while(n < num) {
+            if(gptr_ == egptr_ && (!in_ || underflow() == std::char_traits<char_type>::eof())) break;
+
+            size_t const k = std::min(num - n, size_t(egptr_ - gptr_));
+            std::memcpy(outp + n, gptr_, k);
+            gptr_ += k;
+            n += k;
+        }
+        eof_ = (n < num);
+        gcount_ = n;
+        return *this;
+    }
+
+    /**
+     * \brief Tests whether the stream is \em good
+     * 
+     * This is the case unless EOF has been reached after the last reading operation
+     * 
+     * \return true if there is still data available on the stream
+     * \return false if EOF has been reached
+     */
+    inline bool good() const { return !eof_; }
+
+    /**
+     * \brief Equivalent to calling \ref good . 
+     */
+    explicit inline operator bool() const { return good(); }
+
+    /**
+     * \brief Reports the number of successfully read characters during the last \ref get or \ref read operation
+     * 
+     * \return size_t the number of read characters
+     */
+    inline size_t gcount() const { return gcount_; }
+
+    /**
+     * \brief Reports the next reading position in the decompressed stream
+     * 
+     * \return pos_type the next reading position in the decompressed stream
+     */
+    inline pos_type tellg() const {
+        return foffs_ + (gptr_ - outbuf_.get());
+    }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator over the decompressed stream starting at the current stream position
+     * 
+     * \return an input iterator starting at the current stream position
+     */
+    inline auto begin() { return StreamInputIterator<DecompressingInputStream>(*this); }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator marking the end of the decompressed stream
+     * 
+     * \return an input iterator marking the end of the decompressed stream
+     */
+    inline auto end() { return StreamInputIterator<DecompressingInputStream>::end(*this); }
+};
+
+/**
+ * \brief \ref iopp::STLOutputStreamLike "Standard output stream like" adaptor that compresses all written characters into another output stream
+ * 
+ * Written characters are buffered and encoded in chunks, and the encoded data is written to the underlying stream.
+ * Since this is an output stream itself, it can be passed to, e.g., \ref bitwise_output_to or \ref StreamOutputIterator .
+ * The underlying stream must outlive this stream.
+ * 
+ * The compressed frame is ended when \ref finish is called or the stream is destroyed.
+ * \ref flush makes everything written so far decodable without ending the frame and flushes the underlying stream.
+ * 
+ * This output stream does \em not support seek operations.
+ * 
+ * \tparam Encoder the \ref iopp::StreamEncoder "encoder" type, e.g., \ref ZstdEncoder or \ref Lz4Encoder
+ * \tparam OutputStream the underlying output stream type
+ */
+template<StreamEncoder Encoder, STLOutputStreamLike OutputStream>
+class CompressingOutputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+    /**
+     * \brief The default size of the buffer for uncompressed data
+     */
+    static constexpr size_t DEFAULT_BUFSIZE = 128 * 1024;
+
+private:
+    OutputStream* out_;
+    Encoder encoder_;
+
+    size_t bufsize_;
+    std::unique_ptr<char[]> buffer_;
+    size_t foffs_; // offset of the current buffer in the uncompressed stream
+
+    char* pptr_;
+    char* epptr_;
+    bool pending_; // whether the current frame needs to be finished
+
+    inline auto sink() {
+        return [this](char const* data, size_t const num){ out_->write(data, num); };
+    }
+
+    // encodes the buffer contents
+    inline void sync() {
+        size_t const num = pptr_ - buffer_.get();
+        if(num) {
+            encoder_.encode(buffer_.get(), num, sink());
+            foffs_ += num;
+            pptr_ = buffer_.get();
+            pending_ = true;
+        }
+    }
+
+public:
+    /**
+     * \brief Constructs a compressing output stream writing to the given output stream
+     * 
+     * \param out the output stream to write compressed data to
+     * \param encoder the encoder
+     * \param bufsize the size of the buffer for uncompressed data
+     */
+    inline CompressingOutputStream(OutputStream& out, Encoder&& encoder, size_t const bufsize = DEFAULT_BUFSIZE)
+        : out_(&out), encoder_(std::move(encoder)), bufsize_(std::max(bufsize, size_t(1))), foffs_(0), pending_(true) {
+
+        buffer_ = std::unique_ptr<char[]>(new char[bufsize_]);
+        pptr_ = buffer_.get();
+        epptr_ = pptr_ + bufsize_;
+    }
+
+    /**
+     * \brief Ends the compressed frame, unless this has already been done via \ref finish
+     */
+    inline ~CompressingOutputStream() {
+        if(out_) {
+            sync();
+            if(pending_) finish();
+        }
+    }
+
+    CompressingOutputStream(CompressingOutputStream const&) = delete;
+    CompressingOutputStream& operator=(CompressingOutputStream const&) = delete;
+
+    inline CompressingOutputStream(CompressingOutputStream&& other)
+        : out_(std::exchange(other.out_, nullptr)),
+          encoder_(std::move(other.encoder_)),
+          bufsize_(other.bufsize_),
+          buffer_(std::move(other.buffer_)),
+          foffs_(other.foffs_),
+          pptr_(std::exchange(other.pptr_, nullptr)),
+          epptr_(std::exchange(other.epptr_, nullptr)),
+          pending_(std::exchange(other.pending_, false)) {
+    }
+
+    CompressingOutputStream& operator=(CompressingOutputStream&&) = delete;
+
+    /**
+     * \brief Writes a single character
+     * 
+     * \return a reference to this stream
+     */
+    inline CompressingOutputStream& put(char_type const c) {
+        if(pptr_ >= epptr_) [[unlikely]] sync();
+        *pptr_++ = c;
+        return *this;
+    }
+
+    /**
+     * \brief Writes multiple characters
+     * 
+     * If the characters do not fit into the buffer, they are encoded directly without being copied first.
+     * 
+     * \param inp the input characters
+     * \param num the number of characters to write
+     * \return a reference to this stream
+     */
+    inline CompressingOutputStream& write(char_type const* inp, size_t const num) {
+        if(num <= size_t(epptr_ - pptr_)) {
+            std::memcpy(pptr_, inp, num);
+            pptr_ += num;
+        } else {
+            sync();
+            encoder_.encode(inp, num, sink());
+            foffs_ += num;
+            pending_ = true;
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Encodes all buffered characters such that everything written so far can be decoded, and flushes the underlying stream
+     * 
+     * \return a reference to this stream
+     */
+    inline CompressingOutputStream& flush() {
+        sync();
+        encoder_.flush(sink());
+        out_->flush();
+        return *this;
+    }
+
+    /**
+     * \brief Encodes all buffered characters, ends the compressed frame and flushes the underlying stream
+     * 
+     * Characters written afterwards are encoded into a new frame.
+     * 
+     * \return a reference to this stream
+     */
+    inline CompressingOutputStream& finish() {
+        sync();
+        encoder_.finish(sink());
+        out_->flush();
+        pending_ = false;
+        return *this;
+    }
+
+    /**
+     * \brief Reports the next write position in the uncompressed stream
+     * 
+     * \return the number of characters written so far
+     */
+    inline pos_type tellp() const {
+        return foffs_ + (pptr_ - buffer_.get());
+    }
+};
+
+}
+
+#endif
@@ -104,6 +104,16 @@ concept STLOutputStreamLike =
 template<typename T, typename Item>
 concept InputIterator = std::input_iterator<T> && std::convertible_to<std::iter_value_t<T>, Item>;
 
+/**
+ * \brief Concept for contiguous iterators over byte-sized items, e.g., `char*`
+ * 
+ * Such iterators allow for reading or writing multiple characters at once directly from or to memory.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept ContiguousCharIterator = std::contiguous_iterator<T> && (sizeof(std::iter_value_t<T>) == 1);
+
 /**
  * \brief Concept for types that accept bitwise input
  * 
@@ -147,6 +157,98 @@ concept BitSource =
         { subject.read(num) } -> std::unsigned_integral;
     };
 
+/**
+ * \brief Concept for \ref iopp::BitSink "bit sinks" that can write a number of bits known at compile time
+ * 
+ * In addition to the requirements of \ref iopp::BitSink , the type must provide a function template `write<N>` accepting an unsigned integer containing the `N` bits to be written.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept FixedWidthBitSink =
+    BitSink<T> &&
+    requires(T subject, uintmax_t bits) {
+        { subject.template write<1>(bits) };
+    };
+
+/**
+ * \brief Concept for \ref iopp::BitSource "bit sources" that can read a number of bits known at compile time
+ * 
+ * In addition to the requirements of \ref iopp::BitSource , the type must provide a function template `read<N>` returning the `N` bits read as an unsigned integer.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept FixedWidthBitSource =
+    BitSource<T> &&
+    requires(T subject) {
+        { subject.template read<1>() } -> std::unsigned_integral;
+    };
+
+/**
+ * \brief Concept for \ref iopp::BitSink "bit sinks" that can write unary codes efficiently
+ * 
+ * In addition to the requirements of \ref iopp::BitSink , the type must provide a function `write_unary` accepting the number to encode, which writes that many 0-bits followed by a 1-bit.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept UnaryBitSink =
+    BitSink<T> &&
+    requires(T subject, uintmax_t n) {
+        { subject.write_unary(n) };
+    };
+
+/**
+ * \brief Concept for \ref iopp::BitSource "bit sources" that can read unary codes efficiently
+ * 
+ * In addition to the requirements of \ref iopp::BitSource , the type must provide a function `read_unary` that returns the number of 0-bits up to the next 1-bit, consuming the latter.
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept UnaryBitSource =
+    BitSource<T> &&
+    requires(T subject) {
+        { subject.read_unary() } -> std::unsigned_integral;
+    };
+
+/**
+ * \brief Writes a number of bits known at compile time to a \ref iopp::BitSink "BitSink"
+ * 
+ * If the sink is a \ref iopp::FixedWidthBitSink "FixedWidthBitSink", its `write<N>` is used, otherwise the bits are written using the general `write`.
+ * 
+ * \tparam N the number of bits to write
+ * \param sink the bit sink
+ * \param bits the unsigned integer containing the bits to be written
+ */
+template<size_t N, BitSink Sink>
+inline void write_bits(Sink& sink, uintmax_t const bits) {
+    if constexpr(FixedWidthBitSink<Sink>) {
+        sink.template write<N>(bits);
+    } else {
+        sink.write(bits, N);
+    }
+}
+
+/**
+ * \brief Reads a number of bits known at compile time from a \ref iopp::BitSource "BitSource"
+ * 
+ * If the source is a \ref iopp::FixedWidthBitSource "FixedWidthBitSource", its `read<N>` is used, otherwise the bits are read using the general `read`.
+ * 
+ * \tparam N the number of bits to read
+ * \param src the bit source
+ * \return the read bits
+ */
+template<size_t N, BitSource Source>
+inline auto read_bits(Source& src) {
+    if constexpr(FixedWidthBitSource<Source>) {
+        return src.template read<N>();
+    } else {
+        return src.read(N);
+    }
+}
+
 }
 
 #endif
@@ -0,0 +1,232 @@
+/**
+ * copy_file.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_COPY_FILE_HPP
+#define _IOPP_COPY_FILE_HPP
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "os/posix.hpp"
+#include "util/buffer_pool.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace iopp {
+
+namespace detail {
+
+#ifdef IOPP_POSIX
+// copies num bytes from in_fd at in_offs to out_fd at out_offs, returns the number of bytes copied
+inline size_t copy_fd_range(int const in_fd, size_t in_offs, int const out_fd, size_t out_offs, size_t const num) {
+    constexpr size_t MAX_CHUNK = size_t(1) << 30;
+    size_t copied = 0;
+
+    #if defined(__linux__) && defined(__GLIBC__)
+    // copy_file_range copies within the kernel and can share extents (reflink) on file systems that support it
+    while(copied < num) {
+        loff_t off_in = in_offs + copied;
+        loff_t off_out = out_offs + copied;
+        auto const n = copy_file_range(in_fd, &off_in, out_fd, &off_out, std::min(num - copied, MAX_CHUNK), 0);
+        if(n > 0) [[likely]] {
+            copied += n;
+        } else if(n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break; // EOF, or not supported for these files (e.g., across file systems on older kernels)
+        }
+    }
+    if(copied == num) return copied;
+    #endif
+
+    #ifdef __linux__
+    // sendfile copies within the kernel as well, but writes at the output's file position
+    if(lseek64(out_fd, out_offs + copied, SEEK_SET) >= 0) {
+        while(copied < num) {
+            off64_t off_in = in_offs + copied;
+            auto const n = sendfile64(out_fd, in_fd, &off_in, std::min(num - copied, MAX_CHUNK));
+            if(n > 0) [[likely]] {
+                copied += n;
+            } else if(n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                break; // EOF or not supported
+            }
+        }
+        if(copied == num) return copied;
+    }
+    #endif
+
+    // copy through a buffer
+    size_t const bufsize = 1024 * 1024;
+    auto buffer = make_stream_buffer(bufsize);
+    while(copied < num) {
+        auto const n = ::pread(in_fd, buffer.get(), std::min(bufsize, num - copied), in_offs + copied);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+
+        size_t written = 0;
+        while(written < size_t(n)) {
+            auto const w = ::pwrite(out_fd, buffer.get() + written, n - written, out_offs + copied + written);
+            if(w < 0 && errno == EINTR) continue;
+            if(w <= 0) return copied + written;
+            written += w;
+        }
+        copied += n;
+    }
+    return copied;
+}
+#endif
+
+inline size_t copy_file(std::filesystem::path const& src, std::filesystem::path const& dst, size_t const begin, size_t const end, bool const append) {
+    if(!std::filesystem::exists(src)) {
+        throw std::logic_error("file does not exist: " + src.string());
+    }
+
+    size_t const actual_end = std::min(end, (size_t)std::filesystem::file_size(src));
+    size_t const actual_begin = std::min(begin, actual_end);
+    size_t const num = actual_end - actual_begin;
+
+    #ifdef IOPP_POSIX
+    int const in_fd = ::open(src.c_str(), O_RDONLY);
+    if(in_fd < 0) return 0;
+
+    const auto mask = umask(0);
+    umask(mask); // needed to restore as per POSIX documentation
+    int const out_fd = ::open(dst.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0666 & ~mask); // nb: copy_file_range does not support O_APPEND
+    if(out_fd < 0) {
+        ::close(in_fd);
+        return 0;
+    }
+
+    size_t out_offs = 0;
+    if(append) {
+        struct stat st;
+        if(fstat(out_fd, &st) == 0) out_offs = st.st_size;
+    }
+
+    size_t const copied = copy_fd_range(in_fd, actual_begin, out_fd, out_offs, num);
+    ::close(out_fd);
+    ::close(in_fd);
+    return copied;
+    #else
+    std::ifstream in(src, std::ios::in | std::ios::binary);
+    std::ofstream out(dst, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    in.seekg(actual_begin, std::ios::beg);
+
+    size_t const bufsize = 1024 * 1024;
+    auto buffer = make_stream_buffer(bufsize);
+    size_t copied = 0;
+    while(copied < num && in) {
+        in.read((char*)buffer.get(), std::min(bufsize, num - copied));
+        size_t const n = in.gcount();
+        if(n == 0) break;
+        out.write((char const*)buffer.get(), n);
+        copied += n;
+    }
+    return copied;
+    #endif
+}
+
+}
+
+/**
+ * \brief Copies a range of a file to another file
+ * 
+ * The destination file is created or overwritten.
+ * The range semantics are the same as for \ref FileInputStream , i.e., the range is clamped to the source file's size.
+ * 
+ * On Linux, the data is copied within the kernel using `copy_file_range`, which may share the underlying storage on file systems that support it (e.g., XFS or btrfs).
+ * If that is not possible, `sendfile` is tried next, and finally, the data is copied through a buffer.
+ * 
+ * Note that an unqualified call with two `std::filesystem::path` arguments is ambiguous with `std::filesystem::copy_file` due to argument-dependent lookup, so call it as `iopp::copy_file`.
+ * 
+ * \param src the source file
+ * \param dst the destination file
+ * \param begin the position of the first byte in the source file to copy
+ * \param end the position of the last byte in the source file to copy
+ * \return the number of bytes copied
+ */
+inline size_t copy_file(std::filesystem::path const& src, std::filesystem::path const& dst, size_t const begin = 0, size_t const end = SIZE_MAX) {
+    return detail::copy_file(src, dst, begin, end, false);
+}
+
+/**
+ * \brief Appends a range of a file to another file
+ * 
+ * The destination file is created if it does not exist.
+ * See \ref copy_file for details.
+ * 
+ * \param src the source file
+ * \param dst the destination file
+ * \param begin the position of the first byte in the source file to append
+ * \param end the position of the last byte in the source file to append
+ * \return the number of bytes appended
+ */
+inline size_t append_file(std::filesystem::path const& src, std::filesystem::path const& dst, size_t const begin = 0, size_t const end = SIZE_MAX) {
+    return detail::copy_file(src, dst, begin, end, true);
+}
+
+/**
+ * \brief Concatenates files into a destination file
+ * 
+ * The destination file is created or overwritten and must not be one of the source files.
+ * See \ref copy_file for details.
+ * 
+ * \param srcs the source files in the order of concatenation
+ * \param dst the destination file
+ * \return the total number of bytes written
+ */
+inline size_t concat_files(std::span<std::filesystem::path const> srcs, std::filesystem::path const& dst) {
+    size_t total = 0;
+    bool first = true;
+    for(auto const& src : srcs) {
+        total += detail::copy_file(src, dst, 0, SIZE_MAX, !first);
+        first = false;
+    }
+    if(first) {
+        // no sources, create an empty file
+        std::ofstream(dst, std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    return total;
+}
+
+}
+
+#endif
@@ -0,0 +1,532 @@
+/**
+ * fd_input_stream.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_FD_INPUT_STREAM_HPP
+#define _IOPP_FD_INPUT_STREAM_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <span>
+#include <utility>
+
+#include "buffer_size.hpp"
+#include "stream_input_iterator.hpp"
+#include "os/posix.hpp"
+#include "util/buffer_pool.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace iopp {
+
+/**
+ * \brief \ref iopp::STLInputStreamLike "Standard input stream like" input stream with a read buffer over an arbitrary file descriptor
+ * 
+ * In contrast to \ref FileInputStream , this stream makes no assumptions about the size of the input and does not seek.
+ * It can therefore read from the standard input, pipes or sockets; reading continues until the writing end is closed.
+ * 
+ * If the file descriptor refers to a pipe, its capacity is increased using `F_SETPIPE_SZ` (if supported) so the writer can run further ahead.
+ * For non-blocking file descriptors, the stream waits for input using `poll`.
+ * 
+ * The remaining input can be forwarded to another file descriptor using \ref transfer_to , which avoids copying through user space where possible.
+ * 
+ * This stream is only available on POSIX systems.
+ */
+class FdInputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+    /**
+     * \brief The pipe capacity requested by default
+     */
+    static constexpr size_t DEFAULT_PIPE_SIZE = 1024 * 1024;
+
+private:
+    using uchar_type = unsigned char;
+
+    int fd_;
+    bool own_;
+    bool is_pipe_;
+    bool is_regular_;
+
+    size_t bufsize_;
+    AlignedBuffer buffer_;
+    size_t foffs_; // number of bytes read from the file descriptor before the current buffer
+
+    bool eof_;
+    uchar_type* eback_;
+    uchar_type* gptr_;
+    uchar_type* egptr_;
+    size_t gcount_;
+
+    inline void setg(uchar_type* gbeg, uchar_type* gcurr, uchar_type* gend) {
+        eback_ = gbeg;
+        gptr_ = gcurr;
+        egptr_ = gend;
+    }
+
+    inline size_t bufcount() const { return egptr_ - eback_; }
+
+    // reads from the file descriptor, waiting for input if it is non-blocking, returns zero on EOF or error
+    inline size_t sys_read(void* outp, size_t const num) {
+        while(true) {
+            auto const n = ::read(fd_, outp, num);
+            if(n >= 0) [[likely]] return n;
+
+            if(errno == EINTR) {
+                continue; // interrupted, try again
+            } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd pfd { fd_, POLLIN, 0 };
+                poll(&pfd, 1, -1);
+            } else {
+                return 0; // error, maybe throw?
+            }
+        }
+    }
+
+    inline int underflow() {
+        foffs_ += bufcount();
+        setg(nullptr, nullptr, nullptr);
+
+        size_t const n = (fd_ >= 0) ? sys_read(buffer_.get(), bufsize_) : 0;
+        if(n > 0) {
+            setg(buffer_.get(), buffer_.get(), buffer_.get() + n);
+            return *gptr_;
+        } else {
+            return std::char_traits<char_type>::eof();
+        }
+    }
+
+    // writes the given data fully to the file descriptor, returning the number of bytes written, which is less than num only in case of an error
+    static inline size_t write_fully(int const fd, void const* inp, size_t const num) {
+        size_t written = 0;
+        while(written < num) {
+            auto const n = ::write(fd, (char const*)inp + written, num - written);
+            if(n > 0) [[likely]] {
+                written += n;
+            } else if(n < 0 && errno == EINTR) {
+                continue;
+            } else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd pfd { fd, POLLOUT, 0 };
+                poll(&pfd, 1, -1);
+            } else {
+                break; // error
+            }
+        }
+        return written;
+    }
+
+    inline void close_fd() {
+        if(own_ && fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+public:
+    inline FdInputStream() : fd_(-1), own_(false), is_pipe_(false), is_regular_(false), bufsize_(0), foffs_(0), eof_(true), gcount_(0) {
+        setg(nullptr, nullptr, nullptr);
+    }
+
+    /**
+     * \brief Constructs a buffered input stream over the given file descriptor
+     * 
+     * Reading starts at the file descriptor's current position, if any.
+     * 
+     * \param fd the file descriptor to read from, e.g., `STDIN_FILENO`
+     * \param own if true, the file descriptor is closed when the stream is destroyed
+     * \param bufsize the size of the read buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize )
+     * \param pipe_size if the file descriptor refers to a pipe, the capacity to request for it; zero leaves it unchanged
+     */
+    inline FdInputStream(int const fd, bool const own = false, size_t const bufsize = BUFSIZE_AUTO, size_t const pipe_size = DEFAULT_PIPE_SIZE)
+        : fd_(fd), own_(own), is_pipe_(false), is_regular_(false), foffs_(0), eof_(false), gcount_(0) {
+
+        setg(nullptr, nullptr, nullptr);
+
+        struct stat st;
+        if(fd_ >= 0 && fstat(fd_, &st) == 0) {
+            is_pipe_ = S_ISFIFO(st.st_mode);
+            is_regular_ = S_ISREG(st.st_mode);
+        }
+
+        #ifdef F_SETPIPE_SZ
+        if(is_pipe_ && pipe_size > 0) {
+            fcntl(fd_, F_SETPIPE_SZ, (int)std::min(pipe_size, size_t(INT32_MAX))); // nb: this may fail due to the system limit, which is fine
+        }
+        #endif
+
+        // nb: the size of the input is unknown, so it is not considered
+        bufsize_ = resolve_bufsize(bufsize, fd_);
+        buffer_ = make_stream_buffer(bufsize_);
+    }
+
+    /**
+     * \brief Opens the file at the given path (e.g., a named pipe) and constructs a buffered input stream over it
+     * 
+     * \param path the path to the file
+     * \param bufsize the size of the read buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize )
+     * \param pipe_size if the file is a pipe, the capacity to request for it; zero leaves it unchanged
+     */
+    inline explicit FdInputStream(std::filesystem::path const& path, size_t const bufsize = BUFSIZE_AUTO, size_t const pipe_size = DEFAULT_PIPE_SIZE)
+        : FdInputStream(::open(path.c_str(), O_RDONLY), true, bufsize, pipe_size) {
+
+        if(fd_ < 0) {
+            throw std::logic_error("failed to open file: " + path.string());
+        }
+    }
+
+    inline ~FdInputStream() {
+        close_fd();
+    }
+
+    FdInputStream(FdInputStream const&) = delete;
+    FdInputStream& operator=(FdInputStream const&) = delete;
+
+    inline FdInputStream(FdInputStream&& other) : FdInputStream() {
+        *this = std::move(other);
+    }
+
+    inline FdInputStream& operator=(FdInputStream&& other) {
+        close_fd();
+
+        fd_ = other.fd_;
+        other.fd_ = -1;
+        own_ = other.own_;
+        is_pipe_ = other.is_pipe_;
+        is_regular_ = other.is_regular_;
+        bufsize_ = other.bufsize_;
+        buffer_ = std::move(other.buffer_);
+        foffs_ = other.foffs_;
+        eof_ = other.eof_;
+        gcount_ = other.gcount_;
+        setg(other.eback_, other.gptr_, other.egptr_);
+
+        other.eof_ = true;
+        other.setg(nullptr, nullptr, nullptr);
+        return *this;
+    }
+
+    /**
+     * \brief Reads a single character
+     * 
+     * \return the read character, or \c std::char_traits<char>::eof() in case EOF has been reached
+     */
+    inline int_type get() {
+        if(gptr_ < egptr_ || underflow() != std::char_traits<char_type>::eof()) [[likely]] {
+            gcount_ = 1;
+            return *gptr_++;
+        } else {
+            eof_ = true;
+            gcount_ = 0;
+            return std::char_traits<char_type>::eof();
+        }
+    }
+
+    /**
+     * \brief Reads multiple characters
+     * 
+     * This blocks until the requested number of characters is available or EOF is reached.
+     * The number of characters successfully read can be retrieved via \ref gcount .
+     * Larger reads bypass the read buffer and are done directly into the output buffer.
+     * 
+     * \param outp the output buffer
+     * \param num the number of characters to read
+     * \return a reference to this stream
+     */
+    inline FdInputStream& read(char_type* outp, size_t const num) {
+        // drain whatever is left in the buffer
+        size_t read = std::min(num, size_t(egptr_ - gptr_));
+        if(read) {
+            std::memcpy(outp, gptr_, read);
+            gptr_ += read;
+        }
+
+        if(read < num && !eof_) {
+            foffs_ += bufcount();
+            setg(nullptr, nullptr, nullptr);
+
+            // read large remainders directly into the output, the tail through the buffer
+            while(num - read >= bufsize_ && !eof_) {
+                size_t const n = sys_read(outp + read, num - read);
+                read += n;
+                foffs_ += n;
+                eof_ = (n == 0);
+            }
+
+            while(read < num && !eof_) {
+                eof_ = (underflow() == std::char_traits<char_type>::eof());
+                if(!eof_) {
+                    size_t const n = std::min(num - read, bufcount());
+                    std::memcpy(outp + read, gptr_, n);
+                    gptr_ += n;
+                    read += n;
+                }
+            }
+        }
+
+        gcount_ = read;
+        return *this;
+    }
+
+    /**
+     * \brief Provides direct access to the characters currently available in the read buffer
+     * 
+     * If the buffer has been exhausted, it is refilled first, which blocks until input is available.
+     * The characters are not consumed; use \ref consume to advance the stream.
+     * 
+     * \return the characters available in the read buffer, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> peek_buffer() {
+        if(gptr_ == egptr_) {
+            eof_ = (underflow() == std::char_traits<char_type>::eof());
+            if(eof_) return {};
+        }
+        return { (char_type const*)gptr_, size_t(egptr_ - gptr_) };
+    }
+
+    /**
+     * \brief Consumes characters from the read buffer
+     * 
+     * The number of characters consumed is limited to those currently available in the buffer and can be retrieved via \ref gcount .
+     * 
+     * \param num the number of characters to consume
+     */
+    inline void consume(size_t const num) {
+        size_t const n = std::min(num, size_t(egptr_ - gptr_));
+        gptr_ += n;
+        gcount_ = n;
+    }
+
+    /**
+     * \brief Reads the next chunk of characters available in the read buffer
+     * 
+     * \return the next chunk of characters, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> next_chunk() {
+        auto const chunk = peek_buffer();
+        consume(chunk.size());
+        return chunk;
+    }
+
+    /**
+     * \brief Forwards the remaining input to another file descriptor
+     * 
+     * Any buffered characters are written first.
+     * The rest is transferred using `splice` if either side is a pipe, or `copy_file_range` between regular files, so no data is copied through user space.
+     * If neither is possible, the data is copied through the read buffer.
+     * 
+     * Afterwards, the stream is at EOF unless the limit was reached or writing failed.
+     * In the latter case, characters that have been read from the input but could not be written remain buffered, so they can still be extracted from this stream or the transfer can be retried.
+     * 
+     * \param out_fd the file descriptor to write to
+     * \param max the maximum number of characters to transfer
+     * \return the number of characters transferred
+     */
+    inline size_t transfer_to(int const out_fd, size_t const max = SIZE_MAX) {
+        size_t transferred = 0;
+
+        // write the buffered characters
+        {
+            size_t const n = std::min(max, size_t(egptr_ - gptr_));
+            size_t const w = n ? write_fully(out_fd, gptr_, n) : 0;
+            gptr_ += w;
+            transferred += w;
+
+            if(w < n) {
+                // writing failed, the unwritten characters remain buffered
+                gcount_ = transferred;
+                return transferred;
+            }
+        }
+
+        if(transferred < max && fd_ >= 0) {
+            foffs_ += bufcount();
+            setg(nullptr, nullptr, nullptr);
+
+            bool out_is_pipe = false, out_is_regular = false;
+            struct stat st;
+            if(fstat(out_fd, &st) == 0) {
+                out_is_pipe = S_ISFIFO(st.st_mode);
+                out_is_regular = S_ISREG(st.st_mode);
+            }
+
+            bool done = false;
+
+            #ifdef SPLICE_F_MOVE
+            if(!done && (is_pipe_ || out_is_pipe)) {
+                while(transferred < max) {
+                    auto const n = splice(fd_, nullptr, out_fd, nullptr, std::min(max - transferred, size_t(1) << 30), SPLICE_F_MOVE | SPLICE_F_MORE);
+                    if(n > 0) [[likely]] {
+                        transferred += n;
+                        foffs_ += n;
+                    } else if(n == 0) {
+                        done = true; // EOF
+                        eof_ = true;
+                        break;
+                    } else if(errno == EINTR) {
+                        continue;
+                    } else if(errno == EAGAIN) {
+                        pollfd pfds[2] = { { fd_, POLLIN, 0 }, { out_fd, POLLOUT, 0 } };
+                        poll(pfds, 2, -1);
+                    } else {
+                        break; // not supported for these file descriptors, fall back
+                    }
+                }
+                if(transferred >= max) done = true;
+            }
+            #endif
+
+            #if defined(__linux__) && defined(__GLIBC__)
+            if(!done && is_regular_ && out_is_regular) {
+                while(transferred < max) {
+                    auto const n = copy_file_range(fd_, nullptr, out_fd, nullptr, std::min(max - transferred, size_t(1) << 30), 0);
+                    if(n > 0) [[likely]] {
+                        transferred += n;
+                        foffs_ += n;
+                    } else if(n == 0) {
+                        done = true; // EOF
+                        eof_ = true;
+                        break;
+                    } else if(errno == EINTR) {
+                        continue;
+                    } else {
+                        break; // not supported for these file descriptors, fall back
+                    }
+                }
+                if(transferred >= max) done = true;
+            }
+            #endif
+
+            // copy through the buffer
+            while(!done && transferred < max) {
+                size_t const n = sys_read(buffer_.get(), std::min(bufsize_, max - transferred));
+                if(n == 0) {
+                    eof_ = true;
+                    break;
+                }
+                size_t const w = write_fully(out_fd, buffer_.get(), n);
+                transferred += w;
+                if(w < n) {
+                    // writing failed, keep the unwritten characters buffered so the caller can retry
+                    setg(buffer_.get(), buffer_.get() + w, buffer_.get() + n);
+                    break;
+                }
+                foffs_ += n;
+            }
+        }
+
+        gcount_ = transferred;
+        return transferred;
+    }
+
+    /**
+     * \brief Forwards the remaining input to a file
+     * 
+     * The file is created or overwritten.
+     * See \ref transfer_to(int, size_t) for details.
+     * 
+     * \param path the path of the file to write to
+     * \param max the maximum number of characters to transfer
+     * \return the number of characters transferred
+     */
+    inline size_t transfer_to(std::filesystem::path const& path, size_t const max = SIZE_MAX) {
+        const auto mask = umask(0);
+        umask(mask); // needed to restore as per POSIX documentation
+        int const out_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 & ~mask);
+        if(out_fd < 0) return 0;
+
+        size_t const n = transfer_to(out_fd, max);
+        ::close(out_fd);
+        return n;
+    }
+
+    /**
+     * \brief Tests whether the stream is \em good
+     * 
+     * This is the case unless EOF has been reached after the last reading operation
+     * 
+     * \return true if there is still data available on the stream
+     * \return false if EOF has been reached
+     */
+    inline bool good() const { return !eof_; }
+
+    /**
+     * \brief Equivalent to calling \ref good . 
+     */
+    explicit inline operator bool() const { return good(); }
+
+    /**
+     * \brief Reports the number of successfully read characters during the last \ref get or \ref read operation
+     * 
+     * \return size_t the number of read characters
+     */
+    inline size_t gcount() const { return gcount_; }
+
+    /**
+     * \brief Reports the number of characters consumed from the stream so far
+     * 
+     * \return pos_type the next reading position in the stream
+     */
+    inline pos_type tellg() const {
+        return foffs_ + (gptr_ - eback_);
+    }
+
+    /**
+     * \brief Reports whether the file descriptor refers to a pipe
+     * 
+     * \return true if the input is a pipe
+     * \return false otherwise
+     */
+    inline bool is_pipe() const { return is_pipe_; }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator over the input starting at the current stream position
+     * 
+     * \return an input iterator starting at the current stream position
+     */
+    inline auto begin() { return StreamInputIterator<FdInputStream>(*this); }
+
+    /**
+     * \brief Returns a \ref StreamInputIterator marking the end of the input
+     * 
+     * \return an input iterator marking the end of the input
+     */
+    inline auto end() { return StreamInputIterator<FdInputStream>::end(*this); }
+};
+
+}
+
+#endif
+
+#endif
@@ -28,15 +28,24 @@
 #ifndef _IOPP_FILE_INPUT_STREAM_HPP
 #define _IOPP_FILE_INPUT_STREAM_HPP
 
+#include <cstring>
+#include <span>
 #include <filesystem>
 #include <iostream>
 #include <memory>
 #include <utility>
 
+#include "buffer_size.hpp"
+#include "cache_mode.hpp"
+#include "instrumentation.hpp"
+#include "io_vec.hpp"
 #include "stream_input_iterator.hpp"
+#include "os/io_uring.hpp"
 #include "os/posix.hpp"
+#include "util/buffer_pool.hpp"
 
 #ifdef IOPP_POSIX
+#include <cerrno>
 #include <unistd.h>
 #include <fcntl.h>
 #else
@@ -50,6 +59,8 @@ namespace iopp {
  *
  * The default implementation is backed by a `std::ifstream` which is always opened in binary mode.
  * On POSIX systems, the faster POSIX file input API is used, also advising the kernel that the file is going to be read sequentially.
+ * On Linux, once the stream has issued a number of reads, further reads are submitted via io_uring if the kernel supports it (see \ref LazyIoUring ).
+ * The interaction with the page cache can be controlled using a \ref CacheMode .
  */
 class FileInputStream {
 public:
@@ -65,15 +76,24 @@ private:
     size_t end_;
     size_t bufsize_;
 
-    std::unique_ptr<uchar_type[]> buffer_;
+    AlignedBuffer buffer_;
     size_t foffs_; // offset in file
 
+    CacheMode cache_mode_;
+    size_t align_; // alignment of file offsets and read sizes for direct I/O
+
 #ifdef IOPP_POSIX
     int fd_;
 #else
     std::ifstream fstream_;
 #endif
 
+#ifdef IOPP_IO_URING
+    LazyIoUring uring_;
+#endif
+
+    [[no_unique_address]] detail::IoProbe probe_;
+
     inline void invalidate_buffer() {
         setg(nullptr, nullptr, nullptr);
         gcount_ = 0;
@@ -109,15 +129,88 @@ private:
         egptr_ = gend;
     }
 
+#ifdef IOPP_POSIX
+    // reads from the current file position, using io_uring if available
+    inline ssize_t sys_read(void* outp, size_t const num) {
+        auto const t0 = probe_.now();
+        ssize_t n;
+        #ifdef IOPP_IO_URING
+        if(auto* ring = uring_.get()) {
+            n = ring->read(outp, num);
+            if(n < 0) {
+                errno = -n;
+                n = -1;
+            }
+        } else {
+            n = ::read(fd_, outp, num);
+        }
+        #else
+        n = ::read(fd_, outp, num);
+        #endif
+        probe_.read(t0, n);
+        return n;
+    }
+
+    // reads into multiple buffers from the current file position, using io_uring if available
+    inline ssize_t sys_readv(iovec const* iov, int const iovcnt) {
+        auto const t0 = probe_.now();
+        ssize_t n;
+        #ifdef IOPP_IO_URING
+        if(auto* ring = uring_.get()) {
+            n = ring->readv(iov, iovcnt);
+            if(n < 0) {
+                errno = -n;
+                n = -1;
+            }
+        } else {
+            n = ::readv(fd_, iov, iovcnt);
+        }
+        #else
+        n = ::readv(fd_, iov, iovcnt);
+        #endif
+        probe_.read(t0, n);
+        return n;
+    }
+#endif
+
+    // evicts the current buffer's range from the page cache in drop-behind mode
+    inline void drop_behind(size_t const offs, size_t const num) {
+        #ifdef IOPP_POSIX
+        if(cache_mode_ == CacheMode::drop_behind && num) {
+            posix_fadvise(fd_, begin_ + offs, num, POSIX_FADV_DONTNEED);
+        }
+        #endif
+    }
+
     inline int underflow() {
+        drop_behind(foffs_, bufcount());
         foffs_ += bufcount();
+        setg(nullptr, nullptr, nullptr);
         
         if(foffs_ < view_size()) {
-            const size_t readnum = std::min(bufsize_, view_size() - foffs_);
+            probe_.underflow();
+
+            uchar_type* const buf = buffer_.get();
+            size_t skip = 0;
             size_t num_read;
 
             #ifdef IOPP_POSIX
-            auto n = ::read(fd_, buffer_.get(), readnum);
+            ssize_t n;
+            if(cache_mode_ == CacheMode::direct) {
+                // read whole aligned blocks and skip the head of the first block
+                size_t const pos = begin_ + foffs_;
+                skip = pos % align_;
+                const size_t readnum = std::min(bufsize_ - skip, view_size() - foffs_);
+                const size_t aligned_num = ((skip + readnum + align_ - 1) / align_) * align_;
+                auto const t0 = probe_.now();
+                n = ::pread(fd_, buf, aligned_num, pos - skip);
+                probe_.read(t0, n);
+                n = (n >= 0) ? std::max(ssize_t(0), std::min(n - ssize_t(skip), ssize_t(readnum))) : n;
+            } else {
+                const size_t readnum = std::min(bufsize_, view_size() - foffs_);
+                n = sys_read(buf, readnum);
+            }
+
             if(n >= 0) {
                 num_read = n;
             } else {
@@ -125,19 +218,50 @@ private:
                 num_read = 0;
             }
             #else
-            fstream_.read((char*)buffer_.get(), readnum);
+            const size_t readnum = std::min(bufsize_, view_size() - foffs_);
+            auto const t0 = probe_.now();
+            fstream_.read((char*)buf, readnum);
             num_read = fstream_.gcount();
+            probe_.read(t0, num_read);
             #endif
 
             if(num_read) {
-                setg(buffer_.get(), buffer_.get(), buffer_.get() + num_read);
-                return *(buffer_.get());
+                setg(buf + skip, buf + skip, buf + skip + num_read);
+                return *(buf + skip);
             }
         }
 
         return std::char_traits<char_type>::eof();
     }
 
+    // reads directly from the file into the given memory, bypassing the read buffer
+    // the buffer must be empty when this is called so that the file position matches the stream position
+    inline size_t read_direct(char_type* outp, size_t const num) {
+        size_t num_read = 0;
+
+        #ifdef IOPP_POSIX
+        while(num_read < num) {
+            auto const n = sys_read(outp + num_read, num - num_read);
+            if(n > 0) [[likely]] {
+                num_read += n;
+            } else if(n < 0 && errno == EINTR) {
+                continue; // interrupted, try again
+            } else {
+                break; // EOF or error, maybe throw?
+            }
+        }
+        #else
+        auto const t0 = probe_.now();
+        fstream_.read(outp, num);
+        num_read = fstream_.gcount();
+        probe_.read(t0, num_read);
+        #endif
+
+        drop_behind(foffs_, num_read);
+        foffs_ += num_read;
+        return num_read;
+    }
+
     inline pos_type seekoff(off_type off, std::ios_base::seekdir dir) {
         // determine target position
         size_t new_foffs;
@@ -153,26 +277,35 @@ private:
             case std::ios::end:
                 new_foffs = view_size() + off;
                 break;
+
+            default:
+                new_foffs = fpos(); // nb: not a valid direction, stay at the current position
+                break;
         }
         
-        if(new_foffs != foffs_) {
+        if(new_foffs >= foffs_ && new_foffs <= foffs_ + bufcount()) {
+            // the target is within the buffered window, simply move there
+            gptr_ = eback() + (new_foffs - foffs_);
+        } else {
             foffs_ = new_foffs;
 
             #ifdef IOPP_POSIX
             lseek64(fd_, begin_ + foffs_, SEEK_SET);
             #else
+            fstream_.clear();
             fstream_.seekg(begin_ + foffs_, std::ios::beg);
             #endif
 
             invalidate_buffer();
         }
+        if(buffer_) eof_ = false; // nb: like std::istream::seekg, seeking clears the EOF state, unless there is no file to read from
         return fpos();
     }
 
     inline pos_type seekpos(pos_type pos) { return seekoff(pos, std::ios::beg); }
 
 public:
-    inline FileInputStream() : bufsize_(0), begin_(0), end_(0), foffs_(0), eof_(true), gcount_(0) {
+    inline FileInputStream() : bufsize_(0), begin_(0), end_(0), foffs_(0), cache_mode_(CacheMode::normal), align_(1), eof_(true), gcount_(0) {
         invalidate_buffer();
 
         #ifdef IOPP_POSIX
@@ -188,10 +321,11 @@ public:
      * \param path the path to the file to read
      * \param begin the position of the first byte to read; this will be considered the beginning of the file, even if the file has prior data
      * \param end the position of the last byte to read; the stream will report EOF once this position is reached, even if the file is larger
-     * \param bufsize the size of the read buffer
+     * \param bufsize the size of the read buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize ); for direct I/O, this is rounded up to a multiple of the required alignment
+     * \param cache_mode determines how the stream interacts with the page cache
      */
-    inline FileInputStream(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const bufsize = 16384)
-        : bufsize_(bufsize), begin_(begin), end_(end), foffs_(0), eof_(false), gcount_(0)
+    inline FileInputStream(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const bufsize = BUFSIZE_AUTO, CacheMode const cache_mode = CacheMode::normal)
+        : bufsize_(bufsize), begin_(begin), end_(end), foffs_(0), cache_mode_(cache_mode), align_(1), eof_(false), gcount_(0)
     {
         invalidate_buffer();
 
@@ -202,13 +336,37 @@ public:
         end_ = std::min(end_, std::filesystem::file_size(path));
         begin_ = std::min(begin_, end_);
 
-        buffer_ = std::make_unique<uchar_type[]>(bufsize_);
-
         #ifdef IOPP_POSIX
-        fd_ = open(path.c_str(), O_RDONLY);
+        fd_ = -1;
+        if(cache_mode_ == CacheMode::direct) {
+            fd_ = open(path.c_str(), O_RDONLY | O_DIRECT);
+            if(fd_ >= 0) {
+                align_ = direct_io_alignment(fd_);
+            } else {
+                cache_mode_ = CacheMode::drop_behind; // direct I/O not supported
+            }
+        }
+        if(fd_ < 0) fd_ = open(path.c_str(), O_RDONLY);
+
+        bufsize_ = resolve_bufsize(bufsize_, fd_, view_size());
+        if(cache_mode_ == CacheMode::direct) {
+            bufsize_ = std::max(align_, ((bufsize_ + align_ - 1) / align_) * align_);
+        }
         posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL); // we expect sequential data access since this is a stream
         lseek64(fd_, begin_, SEEK_SET);
         #else
+        bufsize_ = resolve_bufsize(bufsize_, -1, view_size());
+        #endif
+
+        buffer_ = make_stream_buffer(bufsize_, align_);
+
+        #ifdef IOPP_POSIX
+        #ifdef IOPP_IO_URING
+        if(cache_mode_ != CacheMode::direct) {
+            uring_.arm(fd_, buffer_.get(), bufsize_); // nb: the ring is only set up if enough I/O is done, until then or if that fails, we use the plain system calls
+        }
+        #endif
+        #else
         fstream_ = std::ifstream(path, std::ios::in | std::ios::binary);
         fstream_.seekg(begin_, std::ios::beg);
         #endif
@@ -233,20 +391,30 @@ public:
     }
 
     inline FileInputStream& operator=(FileInputStream&& other) {
+        begin_ = other.begin_;
         end_ = other.end_;
         bufsize_ = other.bufsize_;
         buffer_ = std::move(other.buffer_);
         foffs_ = other.foffs_;
+        cache_mode_ = other.cache_mode_;
+        align_ = other.align_;
         eof_ = other.eof_;
+        gcount_ = other.gcount_;
         setg(other.eback(), other.gptr(), other.egptr());
+        probe_ = other.probe_;
 
         #ifdef IOPP_POSIX
+        if(fd_ >= 0) ::close(fd_);
         fd_ = other.fd_;
         other.fd_ = -1;
         #else
         fstream_ = std::move(other.fstream_);
         #endif
 
+        #ifdef IOPP_IO_URING
+        uring_ = std::move(other.uring_);
+        #endif
+
         return *this;
     }
 
@@ -279,23 +447,44 @@ public:
      * \brief Reads multiple characters
      * 
      * The number of characters successfully read can be retrieved via \ref gcount .
+     * Larger reads bypass the read buffer and are done directly into the output buffer.
      * 
      * \param outp the output buffer
      * \param num the number of characters to read
      * \return a reference to this stream
      */
     inline FileInputStream& read(char_type* outp, const size_t num) {
-        size_t read = 0;
-        while(read < num && !eof_) {
-            // read however much is left to read in buffer
-            while(read < num && gptr_ < egptr_) {
-                *outp++ = *gptr_++;
-                ++read;
+        // drain whatever is left in the buffer
+        size_t read = std::min(num, size_t(egptr_ - gptr_));
+        if(read) {
+            std::memcpy(outp, gptr_, read);
+            gptr_ += read;
+        }
+
+        if(read < num && !eof_) {
+            // the buffer is now empty; read as many full buffer sizes as possible directly into the output
+            // nb: this is not possible with direct I/O, because the output is not aligned
+            size_t const direct = (cache_mode_ == CacheMode::direct) ? 0 : ((num - read) / bufsize_) * bufsize_;
+            if(direct) {
+                drop_behind(foffs_, bufcount());
+                foffs_ += bufcount();
+                setg(nullptr, nullptr, nullptr);
+
+                size_t const avail = foffs_ < view_size() ? view_size() - foffs_ : 0;
+                size_t const num_direct = read_direct(outp + read, std::min(direct, avail));
+                read += num_direct;
+                eof_ = (num_direct < direct);
             }
 
-            // underflow
-            if(read < num) {
+            // read the tail through the buffer
+            while(read < num && !eof_) {
                 eof_ = (underflow() == std::char_traits<char_type>::eof());
+                if(!eof_) {
+                    size_t const n = std::min(num - read, bufcount());
+                    std::memcpy(outp + read, gptr_, n);
+                    gptr_ += n;
+                    read += n;
+                }
             }
         }
 
@@ -303,6 +492,154 @@ public:
         return *this;
     }
 
+    /**
+     * \brief Reads into multiple fragments of memory in order (scatter read)
+     * 
+     * The number of characters successfully read in total can be retrieved via \ref gcount .
+     * Whatever is left in the read buffer is distributed first.
+     * If at least a whole buffer size remains to be read, the remaining fragments are passed to the system's `readv` so that they are filled without copying.
+     * Otherwise, or when direct I/O is used, they are filled through the read buffer.
+     * 
+     * \param iov the I/O vectors describing the fragments to fill
+     * \return a reference to this stream
+     */
+    inline FileInputStream& readv(std::span<IoVec const> iov) {
+        size_t read = 0;
+        size_t i = 0;    // the current fragment
+        size_t offs = 0; // the offset within the current fragment
+
+        // distributes the buffer contents to the fragments, skipping those that have been filled
+        auto drain = [&](){
+            while(i < iov.size()) {
+                if(offs == iov[i].iov_len) {
+                    ++i;
+                    offs = 0;
+                } else if(gptr_ < egptr_) {
+                    size_t const n = std::min(iov[i].iov_len - offs, size_t(egptr_ - gptr_));
+                    std::memcpy((char*)iov[i].iov_base + offs, gptr_, n);
+                    gptr_ += n;
+                    read += n;
+                    offs += n;
+                } else {
+                    break;
+                }
+            }
+        };
+
+        drain();
+
+        #ifdef IOPP_POSIX
+        if(i < iov.size() && !eof_ && cache_mode_ != CacheMode::direct) {
+            size_t remaining = iov[i].iov_len - offs;
+            for(size_t j = i + 1; j < iov.size() && remaining < bufsize_; j++) remaining += iov[j].iov_len;
+
+            if(remaining >= bufsize_) {
+                // the buffer is now empty; read directly into the fragments
+                drop_behind(foffs_, bufcount());
+                foffs_ += bufcount();
+                setg(nullptr, nullptr, nullptr);
+
+                while(i < iov.size() && !eof_) {
+                    // gather the next batch of I/O vectors, limited to the end of the view
+                    size_t avail = foffs_ < view_size() ? view_size() - foffs_ : 0;
+                    iovec in[detail::IOV_BATCH];
+                    int cnt = 0;
+                    size_t requested = 0;
+                    for(size_t j = i, o = offs; j < iov.size() && cnt < int(detail::IOV_BATCH) && avail; j++, o = 0) {
+                        size_t const len = std::min(iov[j].iov_len - o, avail);
+                        if(len) {
+                            in[cnt].iov_base = (char*)iov[j].iov_base + o;
+                            in[cnt].iov_len = len;
+                            ++cnt;
+                            requested += len;
+                            avail -= len;
+                        }
+                    }
+
+                    ssize_t n = cnt ? sys_readv(in, cnt) : 0;
+                    if(n < 0 && errno == EINTR) continue; // interrupted, try again
+                    if(n <= 0) {
+                        eof_ = true; // EOF or error, maybe throw?
+                        break;
+                    }
+
+                    drop_behind(foffs_, n);
+                    foffs_ += n;
+                    read += n;
+
+                    // advance in the fragments
+                    while(n > 0) {
+                        size_t const k = std::min(size_t(n), iov[i].iov_len - offs);
+                        offs += k;
+                        n -= k;
+                        if(offs == iov[i].iov_len) {
+                            ++i;
+                            offs = 0;
+                        }
+                    }
+                    drain(); // nb: the buffer is empty, so this only skips filled fragments
+                }
+            }
+        }
+        #endif
+
+        // fill the remaining fragments through the buffer
+        while(i < iov.size() && !eof_) {
+            eof_ = (underflow() == std::char_traits<char_type>::eof());
+            if(!eof_) drain();
+        }
+
+        gcount_ = read;
+        return *this;
+    }
+
+    /**
+     * \brief Provides direct access to the characters currently available in the read buffer
+     * 
+     * If the buffer has been exhausted, it is refilled first.
+     * The characters are not consumed; use \ref consume to advance the stream.
+     * The returned span remains valid until the next reading or seeking operation.
+     * 
+     * This allows for scanning the input window by window, e.g., using `memchr`, without issuing a call to the stream for every character.
+     * 
+     * \return the characters available in the read buffer, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> peek_buffer() {
+        if(gptr_ == egptr_) {
+            eof_ = (underflow() == std::char_traits<char_type>::eof());
+            if(eof_) return {};
+        }
+        return { (char_type const*)gptr_, size_t(egptr_ - gptr_) };
+    }
+
+    /**
+     * \brief Consumes characters from the read buffer
+     * 
+     * This is meant to be used in conjunction with \ref peek_buffer .
+     * The number of characters consumed is limited to those currently available in the buffer and can be retrieved via \ref gcount .
+     * 
+     * \param num the number of characters to consume
+     */
+    inline void consume(size_t const num) {
+        size_t const n = std::min(num, size_t(egptr_ - gptr_));
+        gptr_ += n;
+        gcount_ = n;
+    }
+
+    /**
+     * \brief Reads the next chunk of characters available in the read buffer
+     * 
+     * This is equivalent to calling \ref peek_buffer followed by consuming the entire span.
+     * The returned span remains valid until the next reading or seeking operation.
+     * 
+     * \return the next chunk of characters, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> next_chunk() {
+        auto const chunk = peek_buffer();
+        consume(chunk.size());
+        return chunk;
+    }
+
     /**
      * \brief Tests whether the stream is \em good
      * 
@@ -337,6 +674,9 @@ public:
     /**
      * \brief Seeks a stream position
      * 
+     * If the target position is within the currently buffered window, the buffer is reused and no system call is made.
+     * Seeking clears the EOF state.
+     * 
      * \param off the position offset to seek
      * \param dir determines that the offset is applied to the beginning, current position ( \ref tellg ) or the end of the stream, respectively
      * \return FileInputStream& a reference to this stream
@@ -359,6 +699,15 @@ public:
      * \return an input iterator marking the end of the file
      */
     inline auto end() { return StreamInputIterator<FileInputStream>::end(*this); }
+
+    /**
+     * \brief Reports the I/O statistics of this stream
+     * 
+     * Unless \ref INSTRUMENTATION_ENABLED "instrumentation is enabled", all statistics are zero.
+     * 
+     * \return the I/O statistics
+     */
+    inline IoStats io_stats() const { return probe_.stats(); }
 };
 
 }
@@ -28,17 +28,27 @@
 #ifndef _IOPP_FILE_OUTPUT_STREAM_HPP
 #define _IOPP_FILE_OUTPUT_STREAM_HPP
 
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <utility>
 
+#include "buffer_size.hpp"
+#include "cache_mode.hpp"
+#include "instrumentation.hpp"
+#include "io_vec.hpp"
+#include "os/io_uring.hpp"
 #include "os/posix.hpp"
+#include "util/buffer_pool.hpp"
 
 #ifdef IOPP_POSIX
+#include <cerrno>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #else
 #include <fstream>
 #endif
@@ -50,6 +60,8 @@ namespace iopp {
  * 
  * The default implementation is backed by a `std::ofstream` which is always opened in binary mode.
  * On POSIX systems, the faster POSIX file input API is used, also advising the kernel that the file is going to be written sequentially.
+ * On Linux, once the stream has issued a number of writes, further writes are submitted via io_uring if the kernel supports it (see \ref LazyIoUring ).
+ * The interaction with the page cache can be controlled using a \ref CacheMode .
  * 
  * This output stream does \em not support seek operations.
  */
@@ -64,14 +76,28 @@ private:
     using uchar_type = unsigned char;
     size_t bufsize_;
 
-    std::unique_ptr<uchar_type[]> buffer_;
+    AlignedBuffer buffer_;
     size_t foffs_; // offset in file
 
+    CacheMode cache_mode_;
+    size_t align_;     // alignment of file offsets and write sizes for direct I/O
+    size_t wb_offs_;   // offset up to which writeback has been initiated in drop-behind mode
+    size_t drop_offs_; // offset up to which data has been evicted from the page cache in drop-behind mode
+
+    // in drop-behind mode, the minimum amount of written data before writeback is initiated
+    static constexpr size_t DROP_BEHIND_WINDOW = 4 * 1024 * 1024;
+
 #ifdef IOPP_POSIX
     int fd_;
 #else
     std::ofstream fstream_;
 #endif
+
+#ifdef IOPP_IO_URING
+    LazyIoUring uring_;
+#endif
+
+    [[no_unique_address]] detail::IoProbe probe_;
     
     inline size_t fpos() const {
         return foffs_ + (pptr() - pbase());
@@ -97,29 +123,218 @@ private:
         epptr_ = pend;
     }
 
-    inline int sync() {
-        // write current buffer contents to file
-        size_t const wnum = bufcount();
+#ifdef IOPP_POSIX
+    // writes to the current file position, using io_uring if available
+    inline ssize_t sys_write(void const* inp, size_t const num) {
+        auto const t0 = probe_.now();
+        ssize_t n;
+        #ifdef IOPP_IO_URING
+        if(auto* ring = uring_.get()) {
+            n = ring->write(inp, num);
+            if(n < 0) {
+                errno = -n;
+                n = -1;
+            }
+        } else {
+            n = ::write(fd_, inp, num);
+        }
+        #else
+        n = ::write(fd_, inp, num);
+        #endif
+        probe_.write(t0, n);
+        return n;
+    }
+
+    // writes multiple buffers to the current file position, using io_uring if available
+    inline ssize_t sys_writev(iovec const* iov, int const iovcnt) {
+        auto const t0 = probe_.now();
+        ssize_t n;
+        #ifdef IOPP_IO_URING
+        if(auto* ring = uring_.get()) {
+            n = ring->writev(iov, iovcnt);
+            if(n < 0) {
+                errno = -n;
+                n = -1;
+            }
+        } else {
+            n = ::writev(fd_, iov, iovcnt);
+        }
+        #else
+        n = ::writev(fd_, iov, iovcnt);
+        #endif
+        probe_.write(t0, n);
+        return n;
+    }
+#endif
 
+    // writes the given memory directly to the file, bypassing the write buffer
+    inline size_t write_direct(uchar_type const* inp, size_t const num) {
         #ifdef IOPP_POSIX
         size_t num_written = 0;
         if(fd_ >= 0) {
-            while(num_written < wnum) {
-                ssize_t const w = ::write(fd_, buffer_.get(), wnum - num_written);
+            while(num_written < num) {
+                ssize_t const w = sys_write(inp + num_written, num - num_written);
                 if(w > 0) [[likely]] {
                     num_written += w;
+                } else if(w < 0 && errno == EINTR) {
+                    continue; // interrupted, try again
                 } else {
                     break; // we may want to throw here?
                 }
             }
         }
         #else
-            fstream_.write((char*)buffer_.get(), wnum);
-            size_t const num_written = wnum; // fstream would have thrown if any error occurred
+            auto const t0 = probe_.now();
+            fstream_.write((char const*)inp, num);
+            size_t const num_written = num; // fstream would have thrown if any error occurred
+            probe_.write(t0, num_written);
         #endif
 
         // advance file position
         foffs_ += num_written;
+        return num_written;
+    }
+
+#ifdef IOPP_POSIX
+    // writes the given I/O vectors to the file, which may be modified in case of partial writes
+    inline void write_vectors(iovec* iovp, int iovcnt) {
+        if(fd_ >= 0) {
+            while(iovcnt > 0) {
+                ssize_t w = sys_writev(iovp, iovcnt);
+                if(w > 0) [[likely]] {
+                    foffs_ += w;
+
+                    // advance in the I/O vectors in case of a partial write
+                    while(iovcnt > 0 && size_t(w) >= iovp->iov_len) {
+                        w -= iovp->iov_len;
+                        ++iovp;
+                        --iovcnt;
+                    }
+                    if(iovcnt > 0) {
+                        iovp->iov_base = (uchar_type*)iovp->iov_base + w;
+                        iovp->iov_len -= w;
+                    }
+                } else if(w < 0 && errno == EINTR) {
+                    continue; // interrupted, try again
+                } else {
+                    break; // we may want to throw here?
+                }
+            }
+        }
+    }
+#endif
+
+    // writes the current buffer contents followed by the given memory directly to the file
+    inline void write_through(uchar_type const* inp, size_t const num) {
+        #ifdef IOPP_POSIX
+        iovec iov[2];
+        iov[0].iov_base = pbase();
+        iov[0].iov_len = bufcount();
+        iov[1].iov_base = (void*)inp;
+        iov[1].iov_len = num;
+
+        if(iov[0].iov_len) {
+            write_vectors(iov, 2);
+        } else {
+            write_vectors(iov + 1, 1);
+        }
+        #else
+        write_direct(pbase(), bufcount());
+        write_direct(inp, num);
+        #endif
+        drop_behind();
+
+        // reset write buffer
+        setp(buffer_.get(), buffer_.get() + bufsize_);
+    }
+
+    // initiates writeback of the data written since the last call and evicts the previously written range from the page cache
+    inline void drop_behind(bool const force = false) {
+        #ifdef IOPP_POSIX
+        if(cache_mode_ == CacheMode::drop_behind && foffs_ > wb_offs_ && (force || foffs_ - wb_offs_ >= DROP_BEHIND_WINDOW)) {
+            #ifdef __linux__
+            sync_file_range(fd_, wb_offs_, foffs_ - wb_offs_, SYNC_FILE_RANGE_WRITE);
+            if(wb_offs_ > drop_offs_) {
+                sync_file_range(fd_, drop_offs_, wb_offs_ - drop_offs_, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            }
+            #endif
+            if(wb_offs_ > drop_offs_) {
+                posix_fadvise(fd_, drop_offs_, wb_offs_ - drop_offs_, POSIX_FADV_DONTNEED);
+            }
+            drop_offs_ = wb_offs_;
+            wb_offs_ = foffs_;
+        }
+        #endif
+    }
+
+#ifdef IOPP_POSIX
+    // writes the aligned prefix of the buffer using direct I/O and moves the unaligned remainder to the beginning of the buffer
+    inline void sync_direct() {
+        size_t const count = bufcount();
+        size_t const aligned = count - count % align_;
+
+        size_t num_written = 0;
+        while(num_written < aligned) {
+            auto const t0 = probe_.now();
+            ssize_t const w = ::pwrite(fd_, pbase() + num_written, aligned - num_written, foffs_ + num_written);
+            probe_.write(t0, w);
+            if(w > 0) [[likely]] {
+                num_written += w;
+            } else if(w < 0 && errno == EINTR) {
+                continue; // interrupted, try again
+            } else {
+                break; // we may want to throw here?
+            }
+        }
+        foffs_ += num_written;
+
+        // keep the remainder, unless an error occurred
+        size_t const rest = (num_written == aligned) ? count - aligned : 0;
+        if(rest && aligned) std::memmove(buffer_.get(), pbase() + aligned, rest);
+
+        setp(buffer_.get(), buffer_.get() + bufsize_);
+        pptr_ += rest;
+    }
+
+    // writes the unaligned remainder of the buffer without direct I/O; it remains in the buffer so it can be rewritten as part of a whole block later
+    inline void sync_direct_tail() {
+        size_t const rest = bufcount();
+        if(rest) {
+            int const flags = fcntl(fd_, F_GETFL);
+            fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+
+            size_t num_written = 0;
+            while(num_written < rest) {
+                auto const t0 = probe_.now();
+                ssize_t const w = ::pwrite(fd_, pbase() + num_written, rest - num_written, foffs_ + num_written);
+                probe_.write(t0, w);
+                if(w > 0) [[likely]] {
+                    num_written += w;
+                } else if(w < 0 && errno == EINTR) {
+                    continue; // interrupted, try again
+                } else {
+                    break; // we may want to throw here?
+                }
+            }
+
+            fcntl(fd_, F_SETFL, flags);
+        }
+    }
+#endif
+
+    inline int sync() {
+        if(bufcount()) probe_.sync();
+
+        #ifdef IOPP_POSIX
+        if(cache_mode_ == CacheMode::direct) {
+            sync_direct();
+            return 0;
+        }
+        #endif
+
+        // write current buffer contents to file
+        write_direct(pbase(), bufcount());
+        drop_behind();
 
         // reset write buffer
         setp(buffer_.get(), buffer_.get() + bufsize_);
@@ -129,7 +344,7 @@ private:
     }
  
 public:
-    inline FileOutputStream() : bufsize_(0), foffs_(0) {
+    inline FileOutputStream() : bufsize_(0), foffs_(0), cache_mode_(CacheMode::normal), align_(1), wb_offs_(0), drop_offs_(0) {
         setp(nullptr, nullptr);
 
         #ifdef IOPP_POSIX
@@ -143,24 +358,51 @@ public:
      * If the file already exists, it will be overwritten.
      * 
      * \param path the path to the file to write
-     * \param bufsize the size of the write buffer
+     * \param bufsize the size of the write buffer, or \ref BUFSIZE_AUTO to choose it automatically (see \ref resolve_bufsize ); for direct I/O, this is rounded up to a multiple of the required alignment
+     * \param cache_mode determines how the stream interacts with the page cache
      */
-    inline FileOutputStream(std::filesystem::path const& path, size_t const bufsize = 16384) : bufsize_(bufsize), foffs_(0) {
-        buffer_ = std::make_unique<uchar_type[]>(bufsize_);
-        setp(buffer_.get(), buffer_.get() + bufsize_);
-
+    inline FileOutputStream(std::filesystem::path const& path, size_t const bufsize = BUFSIZE_AUTO, CacheMode const cache_mode = CacheMode::normal)
+        : bufsize_(bufsize), foffs_(0), cache_mode_(cache_mode), align_(1), wb_offs_(0), drop_offs_(0)
+    {
         #ifdef IOPP_POSIX
         const auto mask = umask(0);
         umask(mask); // needed to restore as per POSIX documentation
-        fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 & ~mask);
+        fd_ = -1;
+        if(cache_mode_ == CacheMode::direct) {
+            fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666 & ~mask);
+            if(fd_ >= 0) {
+                align_ = direct_io_alignment(fd_);
+            } else {
+                cache_mode_ = CacheMode::drop_behind; // direct I/O not supported
+            }
+        }
+        if(fd_ < 0) fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 & ~mask);
         posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL); // we expect sequential data access since this is a stream
+
+        bufsize_ = resolve_bufsize(bufsize_, fd_);
+        if(cache_mode_ == CacheMode::direct) {
+            bufsize_ = std::max(align_, ((bufsize_ + align_ - 1) / align_) * align_);
+        }
+        #else
+        bufsize_ = resolve_bufsize(bufsize_);
+        #endif
+
+        buffer_ = make_stream_buffer(bufsize_, align_);
+        setp(buffer_.get(), buffer_.get() + bufsize_);
+
+        #ifdef IOPP_POSIX
+        #ifdef IOPP_IO_URING
+        if(cache_mode_ != CacheMode::direct) {
+            uring_.arm(fd_, buffer_.get(), bufsize_); // nb: the ring is only set up if enough I/O is done, until then or if that fails, we use the plain system calls
+        }
+        #endif
         #else
         fstream_ = std::ofstream(path, std::ios::out | std::ios::binary);
         #endif
     }
 
     inline ~FileOutputStream() {
-        sync();
+        flush();
 
         #ifdef IOPP_POSIX
         if(fd_ >= 0) {
@@ -183,10 +425,16 @@ public:
         bufsize_ = other.bufsize_;
         buffer_ = std::move(other.buffer_);
         foffs_ = other.foffs_;
+        cache_mode_ = other.cache_mode_;
+        align_ = other.align_;
+        wb_offs_ = other.wb_offs_;
+        drop_offs_ = other.drop_offs_;
+        probe_ = other.probe_;
         
         pbase_ = other.pbase_;
         pptr_ = other.pptr_;
         epptr_ = other.epptr_;
+        other.setp(nullptr, nullptr);
 
         #ifdef IOPP_POSIX
         fd_ = other.fd_;
@@ -195,6 +443,10 @@ public:
         fstream_ = std::move(other.fstream_);
         #endif
 
+        #ifdef IOPP_IO_URING
+        uring_ = std::move(other.uring_);
+        #endif
+
         return *this;
     }
 
@@ -216,19 +468,119 @@ public:
     /**
      * \brief Writes multiple characters
      * 
+     * Unless direct I/O is used, inputs at least as large as the write buffer are written directly to the file without being copied to the buffer.
+     * 
+     * \param inp the input characters
+     * \param num the number of characters to write
      * \return a reference to this stream
      */
     inline FileOutputStream& write(char_type const* inp, const size_t num) {
-        size_t written = 0;
-        while(written < num) {
-            while(written < num && pptr_ < epptr_) {
-                *pptr_++ = *inp++;
-                ++written;
+        size_t const space = epptr_ - pptr_;
+        if(num <= space) {
+            // the input fits into the buffer
+            std::memcpy(pptr_, inp, num);
+            pptr_ += num;
+        } else if(num >= bufsize_ && cache_mode_ != CacheMode::direct) {
+            // the input is larger than the buffer, write it directly along with the current buffer contents
+            // nb: this is not possible with direct I/O, because the input is not aligned
+            write_through((uchar_type const*)inp, num);
+        } else {
+            // fill up the buffer and flush it as often as needed
+            size_t written = 0;
+            while(written < num) {
+                size_t const n = std::min(num - written, size_t(epptr_ - pptr_));
+                std::memcpy(pptr_, inp + written, n);
+                pptr_ += n;
+                written += n;
+
+                if(written < num) {
+                    sync(); // flush when necessary
+                }
             }
+        }
+        return *this;
+    }
 
-            if(written < num) {
-                sync(); // flush when necessary
+    /**
+     * \brief Writes multiple fragments of memory in order (gather write)
+     * 
+     * Fragments smaller than a quarter of the write buffer are merged into the buffer, whereas larger fragments are passed to the system's `writev` along with the buffer contents preceding them, so they are never copied.
+     * Any small fragments following the last large fragment remain in the buffer.
+     * Falls back to calling \ref write for each fragment when direct I/O is used, because the fragments are not aligned.
+     * 
+     * \param iov the I/O vectors describing the fragments to write
+     * \return a reference to this stream
+     */
+    inline FileOutputStream& writev(std::span<IoVec const> iov) {
+        #ifdef IOPP_POSIX
+        if(cache_mode_ != CacheMode::direct) {
+            iovec out[detail::IOV_BATCH];
+            int cnt = 0;
+            uchar_type* mark = pbase_; // beginning of the buffered bytes not yet referenced by an output vector
+
+            // adds an output vector and submits the batch when full
+            auto push = [&](void* base, size_t const len){
+                out[cnt].iov_base = base;
+                out[cnt].iov_len = len;
+                if(++cnt == int(detail::IOV_BATCH)) {
+                    write_vectors(out, cnt);
+                    drop_behind();
+                    cnt = 0;
+
+                    // nb: all buffered bytes have been referenced and written
+                    setp(buffer_.get(), buffer_.get() + bufsize_);
+                    mark = pptr_;
+                }
+            };
+
+            // references the buffered bytes not yet referenced, if any
+            auto push_buffered = [&](){
+                if(pptr_ > mark) {
+                    uchar_type* const m = mark;
+                    mark = pptr_;
+                    push(m, pptr_ - m);
+                }
+            };
+
+            for(auto const& v : iov) {
+                if(!v.iov_len) continue; // nb: empty fragments may not reference any memory
+                if(v.iov_len < bufsize_ / 4) {
+                    // merge small fragment into the buffer
+                    if(v.iov_len > size_t(epptr_ - pptr_)) {
+                        push_buffered();
+                        if(cnt) {
+                            write_vectors(out, cnt);
+                            drop_behind();
+                            cnt = 0;
+                        }
+                        setp(buffer_.get(), buffer_.get() + bufsize_);
+                        mark = pptr_;
+                    }
+                    std::memcpy(pptr_, v.iov_base, v.iov_len);
+                    pptr_ += v.iov_len;
+                } else {
+                    // pass large fragment through
+                    push_buffered();
+                    push(v.iov_base, v.iov_len);
+                }
+            }
+
+            if(cnt) {
+                // write the pending vectors and keep any trailing small fragments in the buffer
+                write_vectors(out, cnt);
+                drop_behind();
+
+                size_t const rest = pptr_ - mark;
+                if(rest && mark > buffer_.get()) std::memmove(buffer_.get(), mark, rest);
+                setp(buffer_.get(), buffer_.get() + bufsize_);
+                pptr_ += rest;
             }
+            return *this;
+        }
+        #endif
+
+        for(auto const& v : iov) {
+            write((char_type const*)v.iov_base, v.iov_len);
         }
         return *this;
     }
@@ -240,6 +592,11 @@ public:
      */
     inline FileOutputStream& flush() {
         sync();
+
+        #ifdef IOPP_POSIX
+        if(cache_mode_ == CacheMode::direct && fd_ >= 0) sync_direct_tail();
+        #endif
+        drop_behind(true);
         return *this;
     }
 
@@ -251,6 +608,15 @@ public:
     inline pos_type tellp() const {
         return fpos();
     }
+
+    /**
+     * \brief Reports the I/O statistics of this stream
+     * 
+     * Unless \ref INSTRUMENTATION_ENABLED "instrumentation is enabled", all statistics are zero.
+     * 
+     * \return the I/O statistics
+     */
+    inline IoStats io_stats() const { return probe_.stats(); }
 };
 
 }
@@ -0,0 +1,405 @@
+/**
+ * instrumentation.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_INSTRUMENTATION_HPP
+#define _IOPP_INSTRUMENTATION_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace iopp {
+
+/**
+ * \brief Tells whether I/O instrumentation has been compiled in
+ * 
+ * Instrumentation is disabled by default.
+ * It is enabled by defining `IOPP_INSTRUMENTATION` before including any iopp header, preferably using the compiler's command line (e.g., `-DIOPP_INSTRUMENTATION`) so that all translation units agree.
+ * When disabled, all recording functions are empty and the reported \ref IoStats are always zero.
+ */
+#ifdef IOPP_INSTRUMENTATION
+constexpr bool INSTRUMENTATION_ENABLED = true;
+#else
+constexpr bool INSTRUMENTATION_ENABLED = false;
+#endif
+
+namespace detail {
+
+inline void counter_add(uint64_t& c, uint64_t const v) { c += v; }
+inline void counter_add(std::atomic<uint64_t>& c, uint64_t const v) { c.fetch_add(v, std::memory_order_relaxed); }
+
+inline void counter_max(uint64_t& c, uint64_t const v) { c = std::max(c, v); }
+inline void counter_max(std::atomic<uint64_t>& c, uint64_t const v) {
+    uint64_t cur = c.load(std::memory_order_relaxed);
+    while(v > cur && !c.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+inline uint64_t counter_load(uint64_t const c) { return c; }
+inline uint64_t counter_load(std::atomic<uint64_t> const& c) { return c.load(std::memory_order_relaxed); }
+
+inline void counter_reset(uint64_t& c) { c = 0; }
+inline void counter_reset(std::atomic<uint64_t>& c) { c.store(0, std::memory_order_relaxed); }
+
+template<typename Counter>
+class BasicLatencyHistogram {
+public:
+    static constexpr size_t NUM_BUCKETS = 48;
+
+private:
+    template<typename> friend class BasicLatencyHistogram;
+
+    std::array<Counter, NUM_BUCKETS> buckets_ = {};
+    Counter count_ = 0;
+    Counter total_ns_ = 0;
+    Counter max_ns_ = 0;
+
+public:
+    /**
+     * \brief Determines the bucket that a latency is counted in
+     * 
+     * Bucket `0` counts latencies of zero nanoseconds, bucket `i > 0` counts latencies in `[2^(i-1), 2^i)` nanoseconds.
+     * The last bucket also counts all greater latencies.
+     * 
+     * \param ns the latency in nanoseconds
+     * \return the bucket index
+     */
+    static constexpr size_t bucket_of(uint64_t const ns) {
+        return std::min(size_t(std::bit_width(ns)), NUM_BUCKETS - 1);
+    }
+
+    /**
+     * \brief Reports the greatest latency counted in the given bucket
+     * 
+     * \param i the bucket index
+     * \return the greatest latency in nanoseconds that falls into the bucket
+     */
+    static constexpr uint64_t bucket_max_ns(size_t const i) {
+        return (i + 1 >= NUM_BUCKETS) ? UINT64_MAX : (uint64_t(1) << i) - 1;
+    }
+
+    /**
+     * \brief Records a latency
+     * 
+     * \param ns the latency in nanoseconds
+     */
+    inline void record(uint64_t const ns) {
+        counter_add(buckets_[bucket_of(ns)], 1);
+        counter_add(count_, 1);
+        counter_add(total_ns_, ns);
+        counter_max(max_ns_, ns);
+    }
+
+    /**
+     * \brief Reports the number of recorded latencies
+     * 
+     * \return the number of recorded latencies
+     */
+    inline uint64_t count() const { return counter_load(count_); }
+
+    /**
+     * \brief Reports the sum of all recorded latencies
+     * 
+     * \return the total latency in nanoseconds
+     */
+    inline uint64_t total_ns() const { return counter_load(total_ns_); }
+
+    /**
+     * \brief Reports the greatest recorded latency
+     * 
+     * \return the greatest latency in nanoseconds
+     */
+    inline uint64_t max_ns() const { return counter_load(max_ns_); }
+
+    /**
+     * \brief Reports the number of latencies counted in the given bucket
+     * 
+     * \param i the bucket index (see \ref bucket_of )
+     * \return the number of latencies in the bucket
+     */
+    inline uint64_t bucket(size_t const i) const { return counter_load(buckets_[i]); }
+
+    /**
+     * \brief Estimates a percentile of the recorded latencies
+     * 
+     * The estimate is the upper bound of the bucket containing the percentile, i.e., it is accurate up to a factor of two.
+     * 
+     * \param p the percentile in `[0, 1]`, e.g., `0.99`
+     * \return the estimated latency in nanoseconds, or zero if nothing has been recorded
+     */
+    inline uint64_t percentile_ns(double const p) const {
+        uint64_t const n = count();
+        if(n == 0) return 0;
+
+        uint64_t const rank = std::max(uint64_t(1), uint64_t(p * n + 0.5));
+        uint64_t acc = 0;
+        for(size_t i = 0; i < NUM_BUCKETS; i++) {
+            acc += bucket(i);
+            if(acc >= rank) return std::min(bucket_max_ns(i), max_ns());
+        }
+        return max_ns();
+    }
+
+    /**
+     * \brief Adds the latencies recorded by another histogram
+     * 
+     * \param other the other histogram
+     * \return a reference to this histogram
+     */
+    template<typename OtherCounter>
+    inline BasicLatencyHistogram& operator+=(BasicLatencyHistogram<OtherCounter> const& other) {
+        for(size_t i = 0; i < NUM_BUCKETS; i++) counter_add(buckets_[i], other.bucket(i));
+        counter_add(count_, other.count());
+        counter_add(total_ns_, other.total_ns());
+        counter_max(max_ns_, other.max_ns());
+        return *this;
+    }
+
+    /**
+     * \brief Discards all recorded latencies
+     */
+    inline void reset() {
+        for(auto& b : buckets_) counter_reset(b);
+        counter_reset(count_);
+        counter_reset(total_ns_);
+        counter_reset(max_ns_);
+    }
+};
+
+template<typename Counter>
+struct BasicIoStats {
+    Counter num_underflows = 0; ///< number of times an input buffer was refilled
+    Counter num_syncs = 0;      ///< number of times an output buffer was handed to the file
+    Counter num_flushes = 0;    ///< number of pack words flushed by bit packers
+    Counter num_reads = 0;      ///< number of read system calls
+    Counter num_writes = 0;     ///< number of write system calls
+    Counter num_maps = 0;       ///< number of memory mappings established
+    Counter num_page_faults = 0; ///< number of page faults while establishing memory mappings, including population
+    Counter bytes_read = 0;     ///< number of bytes read from files
+    Counter bytes_written = 0;  ///< number of bytes written to files
+    Counter bytes_mapped = 0;   ///< number of bytes mapped into memory
+
+    BasicLatencyHistogram<Counter> read_latency;  ///< latencies of read system calls
+    BasicLatencyHistogram<Counter> write_latency; ///< latencies of write system calls, including synchronization of memory mappings
+    BasicLatencyHistogram<Counter> map_latency;   ///< latencies of establishing memory mappings, including population
+
+    inline void record_read(uint64_t const ns, uint64_t const bytes) {
+        counter_add(num_reads, 1);
+        counter_add(bytes_read, bytes);
+        read_latency.record(ns);
+    }
+
+    inline void record_write(uint64_t const ns, uint64_t const bytes) {
+        counter_add(num_writes, 1);
+        counter_add(bytes_written, bytes);
+        write_latency.record(ns);
+    }
+
+    inline void record_map(uint64_t const ns, uint64_t const bytes, uint64_t const page_faults) {
+        counter_add(num_maps, 1);
+        counter_add(bytes_mapped, bytes);
+        counter_add(num_page_faults, page_faults);
+        map_latency.record(ns);
+    }
+
+    /**
+     * \brief Adds the statistics of another instance
+     * 
+     * \param other the other statistics
+     * \return a reference to this instance
+     */
+    template<typename OtherCounter>
+    inline BasicIoStats& operator+=(BasicIoStats<OtherCounter> const& other) {
+        counter_add(num_underflows, counter_load(other.num_underflows));
+        counter_add(num_syncs, counter_load(other.num_syncs));
+        counter_add(num_flushes, counter_load(other.num_flushes));
+        counter_add(num_reads, counter_load(other.num_reads));
+        counter_add(num_writes, counter_load(other.num_writes));
+        counter_add(num_maps, counter_load(other.num_maps));
+        counter_add(num_page_faults, counter_load(other.num_page_faults));
+        counter_add(bytes_read, counter_load(other.bytes_read));
+        counter_add(bytes_written, counter_load(other.bytes_written));
+        counter_add(bytes_mapped, counter_load(other.bytes_mapped));
+        read_latency += other.read_latency;
+        write_latency += other.write_latency;
+        map_latency += other.map_latency;
+        return *this;
+    }
+
+    /**
+     * \brief Resets all statistics to zero
+     */
+    inline void reset() {
+        counter_reset(num_underflows);
+        counter_reset(num_syncs);
+        counter_reset(num_flushes);
+        counter_reset(num_reads);
+        counter_reset(num_writes);
+        counter_reset(num_maps);
+        counter_reset(num_page_faults);
+        counter_reset(bytes_read);
+        counter_reset(bytes_written);
+        counter_reset(bytes_mapped);
+        read_latency.reset();
+        write_latency.reset();
+        map_latency.reset();
+    }
+};
+
+}
+
+/**
+ * \brief Histogram of latencies using logarithmic buckets
+ * 
+ * Bucket `0` counts latencies of zero nanoseconds, bucket `i > 0` counts latencies in `[2^(i-1), 2^i)` nanoseconds.
+ */
+using LatencyHistogram = detail::BasicLatencyHistogram<uint64_t>;
+
+/**
+ * \brief I/O statistics gathered by instrumentation
+ * 
+ * Statistics are kept per object by \ref FileInputStream , \ref FileOutputStream , \ref MemoryMappedFile and \ref BitPacker and reported by their respective `io_stats` functions.
+ * In addition, they are aggregated for the whole process, see \ref process_io_stats .
+ * 
+ * Unless \ref INSTRUMENTATION_ENABLED "instrumentation is enabled", all statistics are zero.
+ */
+using IoStats = detail::BasicIoStats<uint64_t>;
+
+namespace detail {
+
+// the process-wide statistics, updated using relaxed atomic operations
+inline BasicIoStats<std::atomic<uint64_t>>& process_io_stats() {
+    static BasicIoStats<std::atomic<uint64_t>> stats;
+    return stats;
+}
+
+#ifdef IOPP_INSTRUMENTATION
+// records I/O events of a single object into its statistics as well as the process-wide statistics
+class IoProbe {
+private:
+    IoStats stats_;
+
+    static inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point const t0) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    static inline time_point now() { return std::chrono::steady_clock::now(); }
+
+    inline void underflow() {
+        ++stats_.num_underflows;
+        counter_add(process_io_stats().num_underflows, 1);
+    }
+
+    inline void sync() {
+        ++stats_.num_syncs;
+        counter_add(process_io_stats().num_syncs, 1);
+    }
+
+    // nb: flushes are frequent, so they are only counted locally until publish is called
+    inline void flush() {
+        ++stats_.num_flushes;
+    }
+
+    inline void publish_flushes() {
+        counter_add(process_io_stats().num_flushes, stats_.num_flushes);
+    }
+
+    inline void read(time_point const t0, ptrdiff_t const result) {
+        auto const ns = elapsed_ns(t0);
+        uint64_t const bytes = result > 0 ? result : 0;
+        stats_.record_read(ns, bytes);
+        process_io_stats().record_read(ns, bytes);
+    }
+
+    inline void write(time_point const t0, ptrdiff_t const result) {
+        auto const ns = elapsed_ns(t0);
+        uint64_t const bytes = result > 0 ? result : 0;
+        stats_.record_write(ns, bytes);
+        process_io_stats().record_write(ns, bytes);
+    }
+
+    inline void map(time_point const t0, uint64_t const bytes, uint64_t const page_faults) {
+        auto const ns = elapsed_ns(t0);
+        stats_.record_map(ns, bytes, page_faults);
+        process_io_stats().record_map(ns, bytes, page_faults);
+    }
+
+    inline IoStats const& stats() const { return stats_; }
+};
+#else
+// no-op replacement of the probe if instrumentation is disabled
+class IoProbe {
+public:
+    struct time_point {};
+
+    static inline time_point now() { return {}; }
+
+    inline void underflow() {}
+    inline void sync() {}
+    inline void flush() {}
+    inline void publish_flushes() {}
+    inline void read(time_point, ptrdiff_t) {}
+    inline void write(time_point, ptrdiff_t) {}
+    inline void map(time_point, uint64_t, uint64_t) {}
+
+    inline IoStats stats() const { return {}; }
+};
+#endif
+
+}
+
+/**
+ * \brief Reports the I/O statistics aggregated over all instrumented objects of the process
+ * 
+ * File streams and memory mappings contribute immediately, while \ref BitPacker "bit packers" contribute their flush counts upon destruction.
+ * 
+ * \return a snapshot of the process-wide statistics
+ */
+inline IoStats process_io_stats() {
+    IoStats snapshot;
+    snapshot += detail::process_io_stats();
+    return snapshot;
+}
+
+/**
+ * \brief Resets the process-wide I/O statistics to zero
+ * 
+ * This does not affect the statistics of individual objects.
+ */
+inline void reset_process_io_stats() {
+    detail::process_io_stats().reset();
+}
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * io_vec.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_IO_VEC_HPP
+#define _IOPP_IO_VEC_HPP
+
+#include <cstddef>
+
+#include "os/posix.hpp"
+
+#ifdef IOPP_POSIX
+#include <sys/uio.h>
+#endif
+
+namespace iopp {
+
+#ifdef IOPP_POSIX
+/**
+ * \brief Describes a fragment of memory for vectored (scatter/gather) I/O
+ * 
+ * On POSIX systems, this is the system's `iovec` so that I/O vectors can be passed on to the kernel as they are.
+ */
+using IoVec = ::iovec;
+#else
+/**
+ * \brief Describes a fragment of memory for vectored (scatter/gather) I/O
+ * 
+ * This mirrors the POSIX `iovec` structure.
+ */
+struct IoVec {
+    void* iov_base; // the beginning of the fragment
+    size_t iov_len; // the length of the fragment in bytes
+};
+#endif
+
+namespace detail {
+
+// the maximum number of I/O vectors submitted by a single vectored system call
+// nb: this is well below IOV_MAX, so the vectors can be kept on the stack
+constexpr size_t IOV_BATCH = 64;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * lazy_file_buffer.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_LAZY_FILE_BUFFER_HPP
+#define _IOPP_LAZY_FILE_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "random_access_file_reader.hpp"
+
+namespace iopp {
+
+/**
+ * \brief In-memory copy of a file that is materialized lazily, chunk by chunk
+ * 
+ * Construction returns immediately after allocating the memory; the file contents are loaded in chunks of a fixed size.
+ * Before accessing a range, call \ref wait (or use \ref view ), which makes sure that all chunks overlapping the range have been loaded, loading missing chunks on the calling thread.
+ * This way, processing of the beginning of a file can overlap with loading the rest.
+ * 
+ * Optionally, a background thread loads all chunks in order.
+ * Using \ref prefetch , ranges that are needed soon can be handed to the background thread, which loads them before continuing in order.
+ * 
+ * Chunks are loaded from the file using a \ref RandomAccessFileReader , so the calling threads and the background thread never interfere with each other.
+ * All functions may be called by multiple threads concurrently.
+ */
+class LazyFileBuffer {
+public:
+    /**
+     * \brief The default chunk size
+     */
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+private:
+    enum ChunkState : uint8_t {
+        MISSING = 0,
+        LOADING,
+        READY,
+        FAILED,
+    };
+
+    // state shared with the background thread
+    // this is kept on the heap so that the buffer can be moved while the thread is running
+    struct Shared {
+        RandomAccessFileReader reader;
+        std::unique_ptr<char[]> data;
+        size_t size;
+        size_t chunk_size;
+        size_t num_chunks;
+        std::unique_ptr<std::atomic<uint8_t>[]> chunks;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<size_t> requests; // chunks requested to be prefetched
+        size_t sweep;                // the next chunk to be loaded in order by the background thread
+        bool stop;
+
+        inline bool claim(size_t const i) {
+            uint8_t expected = MISSING;
+            return chunks[i].compare_exchange_strong(expected, LOADING, std::memory_order_acq_rel);
+        }
+
+        // loads a claimed chunk and notifies any threads waiting for it
+        inline void load(size_t const i) {
+            size_t const offs = i * chunk_size;
+            size_t const num = std::min(chunk_size, size - offs);
+            size_t const num_read = reader.read_at(offs, data.get() + offs, num);
+            chunks[i].store(num_read == num ? READY : FAILED, std::memory_order_release);
+
+            std::unique_lock lock(mutex); // nb: waiters test the state while holding the lock, so notifying under the lock avoids lost wakeups
+            cv.notify_all();
+        }
+
+        // makes sure the chunk has been loaded, loading it on the calling thread if nobody else does it
+        inline void ensure(size_t const i) {
+            auto state = chunks[i].load(std::memory_order_acquire);
+            if(state == MISSING && claim(i)) {
+                load(i);
+                state = chunks[i].load(std::memory_order_acquire);
+            } else if(state != READY && state != FAILED) {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [&](){
+                    state = chunks[i].load(std::memory_order_acquire);
+                    return state == READY || state == FAILED;
+                });
+            }
+
+            if(state == FAILED) {
+                throw std::runtime_error("failed to load chunk from file");
+            }
+        }
+
+        void run() {
+            std::unique_lock lock(mutex);
+            while(true) {
+                cv.wait(lock, [&](){ return stop || !requests.empty() || sweep < num_chunks; });
+                if(stop) break;
+
+                size_t i;
+                if(!requests.empty()) {
+                    i = requests.front();
+                    requests.pop_front();
+                } else {
+                    i = sweep++;
+                }
+
+                if(chunks[i].load(std::memory_order_relaxed) == MISSING) {
+                    // load without holding the lock
+                    lock.unlock();
+                    if(claim(i)) load(i);
+                    lock.lock();
+                }
+            }
+        }
+    };
+
+    std::unique_ptr<Shared> shared_;
+    std::thread worker_;
+
+    // determines the range of chunks overlapping the given range
+    inline std::pair<size_t, size_t> chunk_range(size_t const offs, size_t const len) const {
+        size_t const end = offs + std::min(len, shared_->size - std::min(offs, shared_->size));
+        if(offs >= end) return { 0, 0 };
+        return { offs / shared_->chunk_size, (end - 1) / shared_->chunk_size + 1 };
+    }
+
+    inline void shutdown() {
+        if(worker_.joinable()) {
+            {
+                std::unique_lock lock(shared_->mutex);
+                shared_->stop = true;
+                shared_->cv.notify_all();
+            }
+            worker_.join();
+        }
+        shared_.reset();
+    }
+
+public:
+    /**
+     * \brief Constructs an empty buffer
+     */
+    inline LazyFileBuffer() {
+    }
+
+    /**
+     * \brief Constructs a lazily materialized buffer for a range of the specified file
+     * 
+     * This only allocates the memory and, if requested, starts the background thread; no data is loaded yet.
+     * 
+     * \param path the path to the file
+     * \param begin the position of the first byte to load
+     * \param end the position after the last byte to load; the buffer ends with the file even if the file is smaller
+     * \param chunk_size the size of the chunks in which the file is loaded
+     * \param background if true, a background thread loads all chunks in order; otherwise, chunks are only loaded on demand or when prefetched
+     */
+    inline LazyFileBuffer(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const chunk_size = DEFAULT_CHUNK_SIZE, bool const background = true) {
+        shared_ = std::make_unique<Shared>();
+        shared_->reader = RandomAccessFileReader(path, begin, end);
+        shared_->size = shared_->reader.size();
+        shared_->chunk_size = std::max(chunk_size, size_t(1));
+        shared_->num_chunks = (shared_->size + shared_->chunk_size - 1) / shared_->chunk_size;
+        shared_->data = std::unique_ptr<char[]>(new char[shared_->size]); // nb: not initialized
+        shared_->chunks = std::make_unique<std::atomic<uint8_t>[]>(shared_->num_chunks);
+        shared_->sweep = background ? 0 : shared_->num_chunks; // nb: without a background thread, only prefetch requests are served
+        shared_->stop = false;
+
+        if(background && shared_->num_chunks > 0) {
+            worker_ = std::thread([s = shared_.get()](){ s->run(); });
+        }
+    }
+
+    /**
+     * \brief Stops the background thread, if any
+     * 
+     * Chunks currently being loaded are completed first.
+     */
+    inline ~LazyFileBuffer() {
+        shutdown();
+    }
+
+    LazyFileBuffer(LazyFileBuffer const&) = delete;
+    LazyFileBuffer& operator=(LazyFileBuffer const&) = delete;
+
+    inline LazyFileBuffer(LazyFileBuffer&& other) {
+        *this = std::move(other);
+    }
+
+    inline LazyFileBuffer& operator=(LazyFileBuffer&& other) {
+        shutdown();
+        shared_ = std::move(other.shared_);
+        worker_ = std::move(other.worker_);
+        return *this;
+    }
+
+    /**
+     * \brief Makes sure that the given range has been loaded
+     * 
+     * Missing chunks are loaded on the calling thread, while chunks currently being loaded by other threads are waited for.
+     * The range is clamped to the size of the buffer.
+     * 
+     * In case a chunk could not be read from the file, a `std::runtime_error` is thrown.
+     * 
+     * \param offs the offset of the first byte of the range
+     * \param len the length of the range
+     */
+    inline void wait(size_t const offs = 0, size_t const len = SIZE_MAX) {
+        if(!shared_) return;
+
+        auto const [first, last] = chunk_range(offs, len);
+        for(size_t i = first; i < last; i++) shared_->ensure(i);
+    }
+
+    /**
+     * \brief Requests that the given range be loaded in the background
+     * 
+     * The chunks overlapping the range are loaded by the background thread before it continues loading in order.
+     * If the buffer has been constructed without a background thread, one is started to serve prefetch requests.
+     * This function returns immediately; use \ref wait before accessing the range.
+     * 
+     * \param offs the offset of the first byte of the range
+     * \param len the length of the range
+     */
+    inline void prefetch(size_t const offs, size_t const len) {
+        if(!shared_) return;
+
+        auto const [first, last] = chunk_range(offs, len);
+        if(first >= last) return;
+
+        std::unique_lock lock(shared_->mutex);
+        for(size_t i = first; i < last; i++) {
+            if(shared_->chunks[i].load(std::memory_order_relaxed) == MISSING) shared_->requests.push_back(i);
+        }
+
+        if(!worker_.joinable()) {
+            worker_ = std::thread([s = shared_.get()](){ s->run(); });
+        }
+        shared_->cv.notify_all();
+    }
+
+    /**
+     * \brief Tests whether the given range has been loaded, without blocking
+     * 
+     * \param offs the offset of the first byte of the range
+     * \param len the length of the range
+     * \return true if all chunks overlapping the range have been loaded
+     * \return false otherwise
+     */
+    inline bool ready(size_t const offs = 0, size_t const len = SIZE_MAX) const {
+        if(!shared_) return true;
+
+        auto const [first, last] = chunk_range(offs, len);
+        for(size_t i = first; i < last; i++) {
+            if(shared_->chunks[i].load(std::memory_order_acquire) != READY) return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Provides access to a range after making sure it has been loaded
+     * 
+     * \param offs the offset of the first byte of the range
+     * \param len the length of the range; it is clamped to the size of the buffer
+     * \return a view on the range
+     */
+    inline std::string_view view(size_t const offs, size_t const len) {
+        wait(offs, len);
+        size_t const n = size();
+        size_t const o = std::min(offs, n);
+        return std::string_view(data() + o, std::min(len, n - o));
+    }
+
+    /**
+     * \brief Provides access to the buffer's memory
+     * 
+     * The contents of a range are only valid after a call to \ref wait or \ref view for that range has returned, or if \ref ready reported true.
+     * 
+     * \return a pointer to the buffer's memory
+     */
+    inline char const* data() const { return shared_ ? shared_->data.get() : nullptr; }
+
+    /**
+     * \brief Reports the size of the buffer
+     * 
+     * \return the number of bytes loaded from the file once the buffer is fully materialized
+     */
+    inline size_t size() const { return shared_ ? shared_->size : 0; }
+
+    /**
+     * \brief Reports the chunk size
+     * 
+     * \return the size of the chunks in which the file is loaded
+     */
+    inline size_t chunk_size() const { return shared_ ? shared_->chunk_size : 0; }
+
+    /**
+     * \brief Reports the number of chunks
+     * 
+     * \return the number of chunks that make up the buffer
+     */
+    inline size_t num_chunks() const { return shared_ ? shared_->num_chunks : 0; }
+};
+
+/**
+ * \brief Loads a range of the specified file lazily
+ * 
+ * This is shorthand for constructing a \ref LazyFileBuffer .
+ * It returns immediately, while the file is loaded by a background thread; use \ref LazyFileBuffer::wait or \ref LazyFileBuffer::view before accessing a range.
+ * 
+ * \param path the file path
+ * \param begin the position of the first byte in the file to load
+ * \param end the position after the last byte in the file to load
+ * \param chunk_size the size of the chunks in which the file is loaded
+ * \return the lazily materialized buffer
+ */
+inline LazyFileBuffer load_file_lazy(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const chunk_size = LazyFileBuffer::DEFAULT_CHUNK_SIZE) {
+    return LazyFileBuffer(path, begin, end, chunk_size, true);
+}
+
+}
+
+#endif
@@ -29,27 +29,172 @@
 #define _IOPP_LOAD_FILE_HPP
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <vector>
 
+#include "concepts.hpp"
 #include "file_input_stream.hpp"
-#include "stream_input_iterator.hpp"
+#include "memory_mapped_file.hpp"
+#include "util/default_init_allocator.hpp"
 
 namespace iopp {
 
+/**
+ * \brief Determines how \ref load_file reads the file
+ */
+enum class LoadMethod {
+    /**
+     * \brief The file is read using a single bulk read of a \ref FileInputStream
+     */
+    read,
+
+    /**
+     * \brief The file is memory-mapped and copied from the mapping
+     * 
+     * If memory mapping is not available or fails, the file is read instead.
+     */
+    mmap,
+};
+
+namespace detail {
+
+inline size_t load_file_size(std::filesystem::path const& path, size_t const begin, size_t const end) {
+    size_t const file_size = std::filesystem::file_size(path);
+    size_t const actual_end = std::min(end, file_size);
+    return actual_end - std::min(begin, actual_end);
+}
+
+}
+
+/**
+ * \brief Loads a range of the specified file into a caller-provided buffer
+ * 
+ * At most as many characters as fit into the buffer are loaded.
+ * The buffer is not initialized beforehand.
+ * 
+ * \param path the file path
+ * \param out the output buffer
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param method the loading method
+ * \return the number of characters loaded
+ */
+inline size_t load_file(std::filesystem::path const& path, std::span<char> out, size_t const begin = 0, size_t const end = SIZE_MAX, LoadMethod const method = LoadMethod::read) {
+    if(out.empty()) return 0;
+
+    if(method == LoadMethod::mmap && MemoryMappedFile::available()) {
+        MemoryMappedFile mmap(path, begin, end, MapMode::read_only, true);
+        if(mmap.data()) {
+            size_t const num = std::min(out.size(), mmap.size());
+            std::memcpy(out.data(), mmap.data(), num);
+            return num;
+        }
+    }
+
+    // nb: reads larger than the buffer size bypass the stream's buffer entirely, so a small one suffices
+    FileInputStream fin(path, begin, end, 4096);
+    fin.read(out.data(), out.size());
+    return fin.gcount();
+}
+
+/**
+ * \brief Loads a range of the specified file into a string
+ * 
+ * The string is resized to fit the range exactly and filled using a single bulk read.
+ * If supported by the standard library, this is done without initializing the string's contents first.
+ * 
+ * \param path the file path
+ * \param out the output string, whose previous contents are discarded
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param method the loading method
+ * \return the number of characters loaded
+ */
+inline size_t load_file(std::filesystem::path const& path, std::string& out, size_t const begin = 0, size_t const end = SIZE_MAX, LoadMethod const method = LoadMethod::read) {
+    size_t const size = detail::load_file_size(path, begin, end);
+
+    #ifdef __cpp_lib_string_resize_and_overwrite
+    out.resize_and_overwrite(size, [&](char* p, size_t const n){
+        return load_file(path, std::span<char>(p, n), begin, end, method);
+    });
+    return out.size();
+    #else
+    out.clear();
+    out.resize(size);
+    out.resize(load_file(path, std::span<char>(out.data(), size), begin, end, method));
+    return out.size();
+    #endif
+}
+
+/**
+ * \brief Loads a range of the specified file into a vector
+ * 
+ * The vector is resized to fit all items contained in the range; trailing bytes that do not make up a full item are not loaded.
+ * The contents are filled using a single bulk read.
+ * To avoid value-initializing the items on resize, use a \ref DefaultInitAllocator (see \ref UninitVector).
+ * 
+ * \tparam T the item type, which must be trivially copyable
+ * \tparam Alloc the vector's allocator type
+ * \param path the file path
+ * \param out the output vector, whose previous contents are discarded
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param method the loading method
+ * \return the number of items loaded
+ */
+template<typename T, typename Alloc>
+requires std::is_trivially_copyable_v<T>
+inline size_t load_file(std::filesystem::path const& path, std::vector<T, Alloc>& out, size_t const begin = 0, size_t const end = SIZE_MAX, LoadMethod const method = LoadMethod::read) {
+    size_t const num_items = detail::load_file_size(path, begin, end) / sizeof(T);
+
+    out.clear();
+    out.resize(num_items);
+    size_t const num_read = load_file(path, std::span<char>((char*)out.data(), num_items * sizeof(T)), begin, end, method);
+    out.resize(num_read / sizeof(T));
+    return out.size();
+}
+
 /**
  * \brief Loads the specified file into a string
  * 
  * \param path the file path
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
  * \return the file's contents
  */
-inline std::string load_file_str(std::filesystem::path const& path) {
+inline std::string load_file_str(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX) {
     std::string s;
-    s.reserve(std::filesystem::file_size(path));
-    {
-        FileInputStream fin(path);
-        std::copy(fin.begin(), fin.end(), std::back_inserter(s));
-    }
-    s.shrink_to_fit();
+    load_file(path, s, begin, end);
+    return s;
+}
+
+/**
+ * \brief Loads the remaining contents of the given input stream into a string
+ * 
+ * This allows for loading data through any \ref iopp::STLInputStreamLike "standard input stream like" adaptor, e.g., a \ref DecompressingInputStream .
+ * Since the size is generally unknown beforehand, the stream is read in chunks until EOF is reached.
+ * 
+ * \tparam InputStream the input stream type
+ * \param in the input stream
+ * \return the stream's remaining contents
+ */
+template<STLInputStreamLike InputStream>
+inline std::string load_file_str(InputStream& in) {
+    static constexpr size_t CHUNK = 64 * 1024;
+
+    std::string s;
+    size_t n;
+    do {
+        size_t const size = s.size();
+        s.resize(size + CHUNK);
+        in.read(s.data() + size, CHUNK);
+        n = in.gcount();
+        s.resize(size + n);
+    } while(n == CHUNK);
     return s;
 }
 
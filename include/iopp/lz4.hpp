@@ -0,0 +1,248 @@
+/**
+ * lz4.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_LZ4_HPP
+#define _IOPP_LZ4_HPP
+
+#if !defined(IOPP_NO_LZ4) && __has_include(<lz4frame.h>)
+#define IOPP_LZ4
+#endif
+
+#ifdef IOPP_LZ4
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <lz4frame.h>
+
+#include "compressed_stream.hpp"
+
+namespace iopp {
+
+namespace detail {
+
+struct Lz4DCtxDeleter {
+    void operator()(LZ4F_dctx* ctx) const { LZ4F_freeDecompressionContext(ctx); }
+};
+
+struct Lz4CCtxDeleter {
+    void operator()(LZ4F_cctx* ctx) const { LZ4F_freeCompressionContext(ctx); }
+};
+
+inline size_t lz4_check(size_t const result) {
+    if(LZ4F_isError(result)) throw std::runtime_error(std::string("lz4: ") + LZ4F_getErrorName(result));
+    return result;
+}
+
+}
+
+/**
+ * \brief \ref iopp::StreamDecoder "Stream decoder" for the LZ4 frame format
+ * 
+ * Concatenated frames are decoded one after another.
+ */
+class Lz4Decoder {
+private:
+    std::unique_ptr<LZ4F_dctx, detail::Lz4DCtxDeleter> ctx_;
+    bool finished_;
+
+public:
+    /**
+     * \brief Constructs a decoder
+     */
+    inline Lz4Decoder() : finished_(true) {
+        LZ4F_dctx* ctx = nullptr;
+        detail::lz4_check(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION));
+        ctx_.reset(ctx);
+    }
+
+    Lz4Decoder(Lz4Decoder&&) = default;
+    Lz4Decoder& operator=(Lz4Decoder&&) = default;
+
+    /**
+     * \brief Decodes as much as possible from the input into the output
+     * 
+     * \param in the beginning of the input, which is advanced past the consumed input
+     * \param in_end the end of the input
+     * \param out the beginning of the output, which is advanced past the produced output
+     * \param out_end the end of the output
+     */
+    inline void decode(char const*& in, char const* in_end, char*& out, char* out_end) {
+        size_t in_size = in_end - in;
+        size_t out_size = out_end - out;
+        size_t const hint = detail::lz4_check(LZ4F_decompress(ctx_.get(), out, &out_size, in, &in_size, nullptr));
+        if(in_size > 0 || out_size > 0) finished_ = (hint == 0);
+        in += in_size;
+        out += out_size;
+    }
+
+    /**
+     * \brief Tells whether the input decoded so far ends at the end of a frame
+     * 
+     * \return true if the input may end here
+     * \return false if the current frame is incomplete
+     */
+    inline bool finished() const { return finished_; }
+};
+
+/**
+ * \brief \ref iopp::StreamEncoder "Stream encoder" for the LZ4 frame format
+ * 
+ * Each call to \ref finish ends the current frame.
+ */
+class Lz4Encoder {
+private:
+    // the maximum number of characters passed to the compressor at once, which determines the buffer size
+    static constexpr size_t MAX_CHUNK = 64 * 1024;
+
+    std::unique_ptr<LZ4F_cctx, detail::Lz4CCtxDeleter> ctx_;
+    LZ4F_preferences_t prefs_;
+    std::unique_ptr<char[]> buffer_;
+    size_t bufsize_;
+    bool begun_; // whether the header of the current frame has been emitted
+
+    template<typename Sink>
+    inline void begin(Sink&& sink) {
+        if(!begun_) {
+            size_t const n = detail::lz4_check(LZ4F_compressBegin(ctx_.get(), buffer_.get(), bufsize_, &prefs_));
+            if(n) sink((char const*)buffer_.get(), n);
+            begun_ = true;
+        }
+    }
+
+public:
+    /**
+     * \brief Constructs an encoder
+     * 
+     * \param level the compression level; zero selects the default fast compression, values of three or more select high compression
+     */
+    inline Lz4Encoder(int const level = 0) : prefs_(), begun_(false) {
+        LZ4F_cctx* ctx = nullptr;
+        detail::lz4_check(LZ4F_createCompressionContext(&ctx, LZ4F_VERSION));
+        ctx_.reset(ctx);
+
+        prefs_.compressionLevel = level;
+        bufsize_ = std::max(LZ4F_compressBound(MAX_CHUNK, &prefs_), size_t(LZ4F_HEADER_SIZE_MAX));
+        buffer_ = std::unique_ptr<char[]>(new char[bufsize_]);
+    }
+
+    Lz4Encoder(Lz4Encoder&&) = default;
+    Lz4Encoder& operator=(Lz4Encoder&&) = default;
+
+    /**
+     * \brief Encodes the given characters
+     * 
+     * \param in the input characters
+     * \param num the number of input characters
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void encode(char const* in, size_t const num, Sink&& sink) {
+        begin(sink);
+        for(size_t i = 0; i < num; i += MAX_CHUNK) {
+            size_t const chunk = std::min(MAX_CHUNK, num - i);
+            size_t const n = detail::lz4_check(LZ4F_compressUpdate(ctx_.get(), buffer_.get(), bufsize_, in + i, chunk, nullptr));
+            if(n) sink((char const*)buffer_.get(), n);
+        }
+    }
+
+    /**
+     * \brief Emits everything encoded so far such that it can be decoded
+     * 
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void flush(Sink&& sink) {
+        if(begun_) {
+            size_t const n = detail::lz4_check(LZ4F_flush(ctx_.get(), buffer_.get(), bufsize_, nullptr));
+            if(n) sink((char const*)buffer_.get(), n);
+        }
+    }
+
+    /**
+     * \brief Ends the current frame
+     * 
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void finish(Sink&& sink) {
+        begin(sink); // nb: make sure that we emit a valid, albeit empty, frame
+        size_t const n = detail::lz4_check(LZ4F_compressEnd(ctx_.get(), buffer_.get(), bufsize_, nullptr));
+        if(n) sink((char const*)buffer_.get(), n);
+        begun_ = false;
+    }
+};
+
+/**
+ * \brief Decompressing input stream for the LZ4 frame format
+ * 
+ * \tparam InputStream the underlying input stream type
+ */
+template<STLInputStreamLike InputStream>
+using Lz4InputStream = DecompressingInputStream<Lz4Decoder, InputStream>;
+
+/**
+ * \brief Compressing output stream for the LZ4 frame format
+ * 
+ * \tparam OutputStream the underlying output stream type
+ */
+template<STLOutputStreamLike OutputStream>
+using Lz4OutputStream = CompressingOutputStream<Lz4Encoder, OutputStream>;
+
+/**
+ * \brief Constructs an \ref Lz4InputStream decompressing the contents of the given input stream
+ * 
+ * \tparam InputStream the input stream type
+ * \param in the input stream, which must outlive the returned stream
+ * \return the decompressing input stream
+ */
+template<STLInputStreamLike InputStream>
+auto lz4_input_from(InputStream& in) {
+    return Lz4InputStream<InputStream>(in, Lz4Decoder());
+}
+
+/**
+ * \brief Constructs an \ref Lz4OutputStream compressing into the given output stream
+ * 
+ * \tparam OutputStream the output stream type
+ * \param out the output stream, which must outlive the returned stream
+ * \param level the compression level
+ * \return the compressing output stream
+ */
+template<STLOutputStreamLike OutputStream>
+auto lz4_output_to(OutputStream& out, int const level = 0) {
+    return Lz4OutputStream<OutputStream>(out, Lz4Encoder(level));
+}
+
+}
+
+#endif
+
+#endif
@@ -28,8 +28,13 @@
 #ifndef _IOPP_MEMORY_MAPPED_HPP
 #define _IOPP_MEMORY_MAPPED_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <filesystem>
 #include <utility>
+#include "instrumentation.hpp"
 #include "os/posix.hpp"
 
 #ifdef IOPP_POSIX
@@ -38,6 +43,7 @@
         #include <fcntl.h>
         #include <sys/stat.h>
         #include <sys/mman.h>
+        #include <sys/resource.h>
 
         #define IOPP_POSIX_MMAP
     #endif
@@ -45,8 +51,68 @@
 
 namespace iopp {
 
+/**
+ * \brief Determines how a file is memory-mapped
+ */
+enum class MapMode {
+    /**
+     * \brief The file is mapped read-only and privately
+     */
+    read_only,
+
+    /**
+     * \brief The file is mapped for reading and writing, modifications are carried through to the file
+     * 
+     * The file is created if it does not exist.
+     */
+    read_write,
+};
+
+/**
+ * \brief Access pattern hints for memory-mapped files
+ * 
+ * These correspond to the respective `madvise` advices on POSIX systems.
+ */
+enum class MapAdvice {
+    /**
+     * \brief No particular access pattern
+     */
+    normal,
+
+    /**
+     * \brief The mapped area will be accessed sequentially, pages can be read ahead aggressively and freed soon after access
+     */
+    sequential,
+
+    /**
+     * \brief The mapped area will be accessed randomly, read-ahead is of little use
+     */
+    random,
+
+    /**
+     * \brief The mapped area will be accessed soon, reading it ahead is beneficial
+     */
+    willneed,
+
+    /**
+     * \brief The mapped area will not be accessed in the near future
+     */
+    dontneed,
+
+    /**
+     * \brief The mapped area should be backed by huge pages if possible
+     * 
+     * This is only supported on Linux with transparent huge pages enabled.
+     */
+    hugepage,
+};
+
 /**
  * \brief Represents a memory-mapped file.
+ * 
+ * Files can be mapped either read-only or writable (see \ref MapMode).
+ * The mapped range may begin at an arbitrary offset; internally, the mapping is extended to start at a page boundary, but \ref data always points to the requested first byte.
+ * Writable mappings can be grown or shrunk using \ref resize and changes can be written back explicitly using \ref sync.
  */
 class MemoryMappedFile {
 private:
@@ -54,10 +120,156 @@ private:
     int    fd_;
     #endif
     
-    size_t size_;
-    void*  data_;
+    size_t  size_;
+    void*   data_;
+    size_t  begin_;
+    MapMode mode_;
+    bool    populate_;
+    bool    huge_pages_;
+
+    void*   base_;     // the actual start of the mapping, which is page-aligned
+    size_t  map_len_;  // the actual length of the mapping
+    size_t  offs_;     // the offset of the requested first byte within the mapping
+
+    [[no_unique_address]] detail::IoProbe probe_;
+
+    #ifdef IOPP_POSIX_MMAP
+    static size_t page_size() {
+        static size_t const page_size = (size_t)sysconf(_SC_PAGESIZE);
+        return page_size;
+    }
+
+    static void* align_up(void* p, size_t const align) {
+        return (void*)(((uintptr_t)p + align - 1) / align * align);
+    }
+
+    // reports the number of page faults of the calling thread so far, if instrumentation is enabled
+    static uint64_t page_faults() {
+        if constexpr(INSTRUMENTATION_ENABLED) {
+            rusage usage;
+            #ifdef RUSAGE_THREAD
+            if(getrusage(RUSAGE_THREAD, &usage) == 0) return usage.ru_minflt + usage.ru_majflt;
+            #else
+            if(getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_minflt + usage.ru_majflt;
+            #endif
+        }
+        return 0;
+    }
+
+    bool map(size_t const len) {
+        if(len == 0) return true; // nb: an empty mapping is fine, but mmap would fail
+
+        auto const t0 = probe_.now();
+        auto const faults0 = page_faults();
+
+        // the file offset must be page-aligned, so we map from the preceding boundary
+        size_t const align = huge_pages_ ? huge_page_size() : page_size();
+        offs_ = begin_ % align;
+        size_t const map_len = offs_ + len;
+        off64_t const map_begin = begin_ - offs_;
+
+        int const prot = (mode_ == MapMode::read_write) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        int flags = (mode_ == MapMode::read_write) ? MAP_SHARED : MAP_PRIVATE;
+        #ifdef MAP_POPULATE
+        if(populate_) flags |= MAP_POPULATE;
+        #endif
+
+        void* base = MAP_FAILED;
+        if(huge_pages_) {
+            // reserve an address range large enough to contain a huge-page-aligned mapping, then map the file into it
+            size_t const reserve_len = map_len + align;
+            void* reserved = mmap64(nullptr, reserve_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if(reserved != MAP_FAILED) {
+                void* aligned = align_up(reserved, align);
+                base = mmap64(aligned, map_len, prot, flags | MAP_FIXED, fd_, map_begin);
+                if(base == MAP_FAILED) {
+                    munmap(reserved, reserve_len);
+                } else {
+                    // release the unused parts of the reservation
+                    size_t const head = (char*)aligned - (char*)reserved;
+                    if(head > 0) munmap(reserved, head);
+
+                    size_t const mapped_end = page_size() * ((head + map_len + page_size() - 1) / page_size());
+                    if(mapped_end < reserve_len) munmap((char*)reserved + mapped_end, reserve_len - mapped_end);
+                }
+            }
+        } else {
+            base = mmap64(nullptr, map_len, prot, flags, fd_, map_begin);
+        }
+        if(base == MAP_FAILED) return false;
+
+        base_ = base;
+        map_len_ = map_len;
+        data_ = (char*)base + offs_;
+        size_ = len;
+
+        if(huge_pages_) advise(MapAdvice::hugepage);
+        #ifndef MAP_POPULATE
+        if(populate_) advise(MapAdvice::willneed);
+        #endif
+
+        probe_.map(t0, len, page_faults() - faults0);
+        return true;
+    }
+
+    // aligns the given range of the mapped area to page boundaries, relative to the start of the mapping
+    std::pair<size_t, size_t> page_range(size_t const offs, size_t const len) const {
+        size_t const start = offs_ + offs - (offs_ + offs) % page_size();
+        size_t const end = offs_ + ((len >= size_ - offs) ? size_ : offs + len);
+        return { start, end - start };
+    }
+    #endif
+
+    void unmap() {
+        #ifdef IOPP_POSIX_MMAP
+        if(base_) munmap(base_, map_len_);
+        #endif
+        base_ = nullptr;
+        map_len_ = 0;
+        offs_ = 0;
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    void release() {
+        unmap();
+        #ifdef IOPP_POSIX_MMAP
+        if(fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+        #endif
+    }
 
 public:
+    /**
+     * \brief Reports the size of huge pages on this system
+     * 
+     * On Linux, this is the size of transparent huge pages as reported by the kernel.
+     * Otherwise, or if that information is unavailable, 2 MiB are assumed.
+     * 
+     * \return the huge page size in bytes
+     */
+    static size_t huge_page_size() {
+        static size_t const huge_page_size = [](){
+            size_t sz = 0;
+            #ifdef IOPP_POSIX_MMAP
+            int const fd = open("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", O_RDONLY);
+            if(fd >= 0) {
+                char buf[32];
+                ssize_t const n = ::read(fd, buf, sizeof(buf) - 1);
+                if(n > 0) {
+                    buf[n] = 0;
+                    sz = std::strtoull(buf, nullptr, 10);
+                }
+                close(fd);
+            }
+            #endif
+            return sz ? sz : size_t(2 * 1024 * 1024);
+        }();
+        return huge_page_size;
+    }
+
     /**
      * \brief Tests whether memory mapping is available on this system
      * 
@@ -74,50 +286,59 @@ public:
         #endif
     }
 
-    inline MemoryMappedFile() : size_(0), data_(nullptr) {
+    inline MemoryMappedFile() : size_(0), data_(nullptr), begin_(0), mode_(MapMode::read_only), populate_(false), huge_pages_(false), base_(nullptr), map_len_(0), offs_(0) {
         #ifdef IOPP_POSIX_MMAP
         fd_ = -1;
         #endif
     }
 
     inline ~MemoryMappedFile() {
-        #ifdef IOPP_POSIX_MMAP
-        if(data_) {
-            munmap(data_, size_);
-            data_ = nullptr;
-        }
-        
-        if(fd_ >= 0) {
-            close(fd_);
-            fd_ = -1;
-        }
-
-        size_ = 0;
-        #endif
+        release();
     }
 
     /**
      * \brief Memory-maps the file at the specified path.
      * 
+     * The first byte to map can be at an arbitrary position; the mapping is internally extended to the preceding page boundary.
+     * 
+     * In \ref MapMode::read_write "read-write" mode, the file is created if it does not exist.
+     * If an end position is given in that case and the file is shorter, it is extended accordingly.
+     * 
+     * If huge page alignment is requested, the mapping is placed at a virtual address and file offset aligned to the \ref huge_page_size "huge page size" and advised to be backed by huge pages.
+     * This allows large ranges to be mapped using few TLB entries, provided that the operating system supports huge pages for file mappings.
+     * 
      * \param path the file to memory-map
      * \param begin the position of the first byte to map
      * \param end the position of the last byte to map
+     * \param mode the mapping mode
+     * \param populate if true, the mapping is populated (prefaulted) immediately, avoiding page faults on subsequent access
+     * \param huge_pages if true, the mapping is aligned to huge pages
      */
-    inline MemoryMappedFile(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX) {
+    inline MemoryMappedFile(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, MapMode const mode = MapMode::read_only, bool const populate = false, bool const huge_pages = false) : MemoryMappedFile() {
+        mode_ = mode;
+        populate_ = populate;
+        huge_pages_ = huge_pages;
+
         #ifdef IOPP_POSIX_MMAP
-        fd_ = open(path.c_str(), O_RDONLY);
+        if(mode == MapMode::read_write) {
+            const auto mask = umask(0);
+            umask(mask); // needed to restore as per POSIX documentation
+            fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0666 & ~mask);
+        } else {
+            fd_ = open(path.c_str(), O_RDONLY);
+        }
         if(fd_ >= 0) {
             struct stat st;
             if(fstat(fd_, &st) >= 0) {
-                size_t const actual_end = std::min(end, (size_t)st.st_size);
-                size_t const actual_begin = std::min(begin, actual_end);
-                size_t const len = actual_end - actual_begin;
-
-                void* data = mmap64(nullptr, len, PROT_READ, MAP_PRIVATE, fd_, actual_begin);
-                if(data != MAP_FAILED) {
-                    data_ = data;
-                    size_ = len;
+                size_t file_size = (size_t)st.st_size;
+                if(mode == MapMode::read_write && end != SIZE_MAX && end > file_size) {
+                    // extend the file to the requested end
+                    if(ftruncate64(fd_, end) >= 0) file_size = end;
                 }
+
+                size_t const actual_end = std::min(end, file_size);
+                begin_ = std::min(begin, actual_end);
+                map(actual_end - begin_);
             }
         }
         #endif
@@ -128,11 +349,26 @@ public:
     }
 
     inline MemoryMappedFile& operator=(MemoryMappedFile&& other) {
+        release();
+
         size_ = other.size_;
         other.size_ = 0;
         
         data_ = other.data_;
         other.data_ = nullptr;
+
+        begin_ = other.begin_;
+        mode_ = other.mode_;
+        populate_ = other.populate_;
+        huge_pages_ = other.huge_pages_;
+
+        base_ = other.base_;
+        other.base_ = nullptr;
+        map_len_ = other.map_len_;
+        other.map_len_ = 0;
+        offs_ = other.offs_;
+        other.offs_ = 0;
+        probe_ = other.probe_;
         
         #ifdef IOPP_POSIX_MMAP
         fd_ = other.fd_;
@@ -145,6 +381,123 @@ public:
     MemoryMappedFile(MemoryMappedFile const&) = delete;
     MemoryMappedFile& operator=(MemoryMappedFile const&) = delete;
 
+    /**
+     * \brief Changes the size of a writable mapping
+     * 
+     * The underlying file is truncated or extended to end exactly after the mapped area, i.e., any file contents beyond it are lost.
+     * On Linux, the mapping is resized using `mremap`, which may move it in memory; otherwise, the file is re-mapped.
+     * In any case, pointers previously obtained via \ref data become invalid.
+     * 
+     * If resizing fails, the file and the mapping are restored to their previous size.
+     * Only if the file has already been shrunk and mapping it fails, the truncated contents are lost.
+     * 
+     * \param new_size the new size of the mapped area
+     * \return true if the mapping has been resized successfully
+     * \return false if the file is not mapped in \ref MapMode::read_write "read-write" mode or resizing failed
+     */
+    inline bool resize(size_t const new_size) {
+        #ifdef IOPP_POSIX_MMAP
+        if(mode_ != MapMode::read_write || fd_ < 0) return false;
+        if(new_size == size_) return true;
+
+        size_t const old_size = size_;
+        if(new_size < old_size) unmap(); // nb: unmap before truncating, accessing truncated pages would raise SIGBUS
+        if(ftruncate64(fd_, begin_ + new_size) < 0) {
+            // the file has not been changed, restore the mapping if it has been unmapped
+            if(!base_) map(old_size);
+            return false;
+        }
+
+        #if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        if(base_ && new_size > 0 && !huge_pages_) { // nb: mremap may not retain huge page alignment
+            void* base = mremap(base_, map_len_, offs_ + new_size, MREMAP_MAYMOVE);
+            if(base == MAP_FAILED) {
+                // the mapping is still intact, restore the file size
+                ftruncate64(fd_, begin_ + old_size);
+                return false;
+            }
+            base_ = base;
+            map_len_ = offs_ + new_size;
+            data_ = (char*)base + offs_;
+            size_ = new_size;
+            return true;
+        }
+        #endif
+
+        unmap();
+        if(map(new_size)) return true;
+
+        // restore the previous size
+        ftruncate64(fd_, begin_ + old_size);
+        map(old_size);
+        return false;
+        #else
+        return false;
+        #endif
+    }
+
+    /**
+     * \brief Writes modifications of a writable mapping back to the file
+     * 
+     * \param offs the offset of the first byte of the range to synchronize, relative to the mapped area
+     * \param len the length of the range to synchronize
+     * \param async if true, writeback is only initiated and the function returns immediately; otherwise, it waits until the data has been written
+     * \return true if the synchronization succeeded
+     * \return false otherwise
+     */
+    inline bool sync(size_t const offs = 0, size_t const len = SIZE_MAX, bool const async = false) {
+        #ifdef IOPP_POSIX_MMAP
+        if(mode_ != MapMode::read_write) return false;
+        if(!data_ || offs >= size_) return true;
+
+        // msync requires a page-aligned start address
+        auto const [start, num] = page_range(offs, len);
+        auto const t0 = probe_.now();
+        bool const result = msync((char*)base_ + start, num, async ? MS_ASYNC : MS_SYNC) == 0;
+        probe_.write(t0, result ? num : 0);
+        return result;
+        #else
+        return false;
+        #endif
+    }
+
+    /**
+     * \brief Advises the operating system about how a range of the mapped area is going to be accessed
+     * 
+     * \param advice the access pattern hint
+     * \param offs the offset of the first byte of the range, relative to the mapped area
+     * \param len the length of the range
+     * \return true if the advice was accepted
+     * \return false if it was rejected or is not supported on this system
+     */
+    inline bool advise(MapAdvice const advice, size_t const offs = 0, size_t const len = SIZE_MAX) {
+        #ifdef IOPP_POSIX_MMAP
+        if(!data_ || offs >= size_) return false;
+
+        int adv;
+        switch(advice) {
+            case MapAdvice::normal:     adv = MADV_NORMAL; break;
+            case MapAdvice::sequential: adv = MADV_SEQUENTIAL; break;
+            case MapAdvice::random:     adv = MADV_RANDOM; break;
+            case MapAdvice::willneed:   adv = MADV_WILLNEED; break;
+            case MapAdvice::dontneed:   adv = MADV_DONTNEED; break;
+            case MapAdvice::hugepage:
+                #ifdef MADV_HUGEPAGE
+                adv = MADV_HUGEPAGE; break;
+                #else
+                return false;
+                #endif
+            default: return false;
+        }
+
+        // madvise requires a page-aligned start address
+        auto const [start, num] = page_range(offs, len);
+        return madvise((char*)base_ + start, num, adv) == 0;
+        #else
+        return false;
+        #endif
+    }
+
     /**
      * \brief Provides access to the file's mapped memory area
      * 
@@ -154,6 +507,17 @@ public:
         return data_;
     }
 
+    /**
+     * \brief Provides writable access to the file's mapped memory area
+     * 
+     * The memory may only be written if the file is mapped in \ref MapMode::read_write "read-write" mode.
+     * 
+     * \return a pointer to the file's mapped memory area
+     */
+    inline void* data() {
+        return data_;
+    }
+
     /**
      * \brief Reports the size of the memory-mapped area
      * 
@@ -162,6 +526,28 @@ public:
     inline const size_t size() const {
         return size_;
     }
+
+    /**
+     * \brief Reports whether the file is mapped in \ref MapMode::read_write "read-write" mode
+     * 
+     * \return true if the mapping is writable
+     * \return false otherwise
+     */
+    inline bool writable() const {
+        return mode_ == MapMode::read_write;
+    }
+
+    /**
+     * \brief Reports the I/O statistics of this mapping
+     * 
+     * This includes the time spent establishing the mapping, which covers populating it if requested, as well as the number of page faults incurred by the calling thread meanwhile.
+     * Page faults on later access are not attributed to the mapping.
+     * Synchronizations via \ref sync are reported as writes.
+     * Unless \ref INSTRUMENTATION_ENABLED "instrumentation is enabled", all statistics are zero.
+     * 
+     * \return the I/O statistics
+     */
+    inline IoStats io_stats() const { return probe_.stats(); }
 };
 
 }
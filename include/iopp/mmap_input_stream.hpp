@@ -0,0 +1,279 @@
+/**
+ * mmap_input_stream.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_MMAP_INPUT_STREAM_HPP
+#define _IOPP_MMAP_INPUT_STREAM_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <span>
+#include <utility>
+
+#include "memory_mapped_file.hpp"
+
+namespace iopp {
+
+/**
+ * \brief \ref iopp::STLInputStreamLike "Standard input stream like" input stream over a \ref MemoryMappedFile
+ * 
+ * Reading from this stream involves no buffering and no system calls; characters are taken directly from the mapped memory.
+ * 
+ * In contrast to other streams, \ref begin and \ref end return contiguous iterators (pointers) into the mapped memory.
+ * This allows for word-wise processing by, e.g., \ref CharPacker or `std::copy`.
+ * Note that iterating over these pointers does not advance the stream.
+ * 
+ * If the file cannot be mapped (or memory mapping is not \ref MemoryMappedFile::available "available"), the stream is empty.
+ */
+class MmapInputStream {
+public:
+    using pos_type = size_t;
+    using off_type = ssize_t;
+    using char_type = char;
+    using int_type = int;
+
+private:
+    MemoryMappedFile mmap_;
+    char_type const* begin_;
+    char_type const* end_;
+    char_type const* pos_;
+    bool eof_;
+    size_t gcount_;
+
+    void init() {
+        begin_ = (char_type const*)mmap_.data();
+        end_ = begin_ + mmap_.size();
+        pos_ = begin_;
+        eof_ = (begin_ == end_);
+        gcount_ = 0;
+    }
+
+public:
+    inline MmapInputStream() : begin_(nullptr), end_(nullptr), pos_(nullptr), eof_(true), gcount_(0) {
+    }
+
+    /**
+     * \brief Constructs an input stream over the given memory mapping
+     * 
+     * \param mmap the memory-mapped file
+     */
+    inline explicit MmapInputStream(MemoryMappedFile&& mmap) : mmap_(std::move(mmap)) {
+        init();
+    }
+
+    /**
+     * \brief Memory-maps the file at the specified path and constructs an input stream over it
+     * 
+     * The mapping is advised to be accessed sequentially.
+     * 
+     * \param path the path to the input file
+     * \param begin the position of the first byte in the file to read
+     * \param end the position of the last byte in the file to read
+     * \param populate if true, the mapping is populated immediately, avoiding page faults during reading
+     */
+    inline MmapInputStream(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, bool const populate = false)
+        : mmap_(path, begin, end, MapMode::read_only, populate) {
+
+        mmap_.advise(MapAdvice::sequential);
+        init();
+    }
+
+    inline MmapInputStream(MmapInputStream&& other) : MmapInputStream() {
+        *this = std::move(other);
+    }
+
+    inline MmapInputStream& operator=(MmapInputStream&& other) {
+        mmap_ = std::move(other.mmap_); // nb: this does not move the mapped memory, so the pointers remain valid
+        begin_ = other.begin_;
+        end_ = other.end_;
+        pos_ = other.pos_;
+        eof_ = other.eof_;
+        gcount_ = other.gcount_;
+
+        other.begin_ = other.end_ = other.pos_ = nullptr;
+        other.eof_ = true;
+        other.gcount_ = 0;
+        return *this;
+    }
+
+    MmapInputStream(MmapInputStream const&) = delete;
+    MmapInputStream& operator=(MmapInputStream const&) = delete;
+
+    /**
+     * \brief Reads a single character
+     * 
+     * \return the read character, or \c std::char_traits<char>::eof() in case EOF has been reached
+     */
+    inline int_type get() {
+        if(pos_ < end_) [[likely]] {
+            gcount_ = 1;
+            return (unsigned char)*pos_++;
+        } else {
+            eof_ = true;
+            gcount_ = 0;
+            return std::char_traits<char_type>::eof();
+        }
+    }
+
+    /**
+     * \brief Reads multiple characters
+     * 
+     * The number of characters successfully read can be retrieved via \ref gcount .
+     * 
+     * \param outp the output buffer
+     * \param num the number of characters to read
+     * \return a reference to this stream
+     */
+    inline MmapInputStream& read(char_type* outp, size_t const num) {
+        size_t const n = std::min(num, size_t(end_ - pos_));
+        if(n) {
+            std::memcpy(outp, pos_, n);
+            pos_ += n;
+        }
+        eof_ = (n < num);
+        gcount_ = n;
+        return *this;
+    }
+
+    /**
+     * \brief Provides direct access to the remaining characters
+     * 
+     * This corresponds to \ref FileInputStream::peek_buffer , but since there is no buffering, the span covers the entire remaining input.
+     * 
+     * \return the remaining characters, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> peek_buffer() {
+        eof_ = (pos_ == end_);
+        return { pos_, size_t(end_ - pos_) };
+    }
+
+    /**
+     * \brief Consumes characters
+     * 
+     * The number of characters consumed can be retrieved via \ref gcount .
+     * 
+     * \param num the number of characters to consume
+     */
+    inline void consume(size_t const num) {
+        size_t const n = std::min(num, size_t(end_ - pos_));
+        pos_ += n;
+        gcount_ = n;
+    }
+
+    /**
+     * \brief Reads all remaining characters as one chunk
+     * 
+     * This is equivalent to calling \ref peek_buffer followed by consuming the entire span.
+     * 
+     * \return the remaining characters, or an empty span if EOF has been reached
+     */
+    inline std::span<char_type const> next_chunk() {
+        auto const chunk = peek_buffer();
+        consume(chunk.size());
+        return chunk;
+    }
+
+    /**
+     * \brief Tests whether the stream is \em good
+     * 
+     * This is the case unless EOF has been reached after the last reading operation
+     * 
+     * \return true if there is still data available on the stream
+     * \return false if EOF has been reached
+     */
+    inline bool good() const { return !eof_; }
+
+    /**
+     * \brief Equivalent to calling \ref good . 
+     */
+    explicit inline operator bool() const { return good(); }
+
+    /**
+     * \brief Reports the number of successfully read characters during the last \ref get or \ref read operation
+     * 
+     * \return size_t the number of read characters
+     */
+    inline size_t gcount() const { return gcount_; }
+
+    /**
+     * \brief Reports the next reading position in the stream
+     * 
+     * \return pos_type the next reading position in the stream
+     */
+    inline pos_type tellg() const {
+        return pos_ - begin_;
+    }
+
+    /**
+     * \brief Seeks a stream position
+     * 
+     * The resulting position is clamped to the mapped range.
+     * 
+     * \param off the position offset to seek
+     * \param dir determines that the offset is applied to the beginning, current position ( \ref tellg ) or the end of the stream, respectively
+     * \return MmapInputStream& a reference to this stream
+     */
+    inline MmapInputStream& seekg(off_type off, std::ios_base::seekdir dir) {
+        char_type const* base;
+        switch(dir) {
+            case std::ios::cur: base = pos_; break;
+            case std::ios::end: base = end_; break;
+            default:            base = begin_; break;
+        }
+
+        off = std::clamp(off, off_type(begin_ - base), off_type(end_ - base));
+        pos_ = base + off;
+        eof_ = false;
+        return *this;
+    }
+
+    /**
+     * \brief Returns a pointer to the current stream position in the mapped memory
+     * 
+     * \return a contiguous iterator starting at the current stream position
+     */
+    inline char_type const* begin() const { return pos_; }
+
+    /**
+     * \brief Returns a pointer marking the end of the mapped memory
+     * 
+     * \return a contiguous iterator marking the end of the input
+     */
+    inline char_type const* end() const { return end_; }
+
+    /**
+     * \brief Provides access to the underlying memory mapping
+     * 
+     * \return the memory-mapped file
+     */
+    inline MemoryMappedFile const& mapping() const { return mmap_; }
+};
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+/**
+ * os/io_uring.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _IOPP_IO_URING_HPP
+#define _IOPP_IO_URING_HPP
+
+#if defined(__linux__) && !defined(IOPP_NO_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#define IOPP_IO_URING
+#endif
+#endif
+
+#ifdef IOPP_IO_URING
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace iopp {
+
+/**
+ * \brief Minimal synchronous io_uring backend for reading from and writing to a single file
+ * 
+ * The ring is set up directly using the kernel interface, no external library is required.
+ * The file and, optionally, one I/O buffer are registered with the ring, which saves the kernel from looking up the file and mapping the buffer on every request.
+ * 
+ * All operations use and advance the file's current position just like `read` and `write` do, so they can be mixed with `lseek` and the plain system calls.
+ * 
+ * Whether io_uring can actually be used is only known at runtime; if \ref init fails, the ring is left \em invalid and the caller is expected to fall back to the plain system calls.
+ * 
+ * Define `IOPP_NO_IO_URING` to disable this backend at compile time.
+ */
+class IoUring {
+private:
+    static constexpr uint64_t CURRENT_POS = uint64_t(-1);
+
+    int ring_fd_;
+    bool fixed_file_;
+    int fd_;
+
+    void* buf_;
+    size_t bufsize_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    uint32_t* sq_head_;
+    uint32_t* sq_tail_;
+    uint32_t* sq_mask_;
+    uint32_t* sq_array_;
+    uint32_t* cq_head_;
+    uint32_t* cq_tail_;
+    uint32_t* cq_mask_;
+    io_uring_cqe* cqes_;
+
+    static uint32_t load_acquire(uint32_t* p) { return std::atomic_ref<uint32_t>(*p).load(std::memory_order_acquire); }
+    static void store_release(uint32_t* p, uint32_t v) { std::atomic_ref<uint32_t>(*p).store(v, std::memory_order_release); }
+
+    void reset() {
+        ring_fd_ = -1;
+        fixed_file_ = false;
+        fd_ = -1;
+        buf_ = nullptr;
+        bufsize_ = 0;
+        sq_ring_ = nullptr;
+        sq_ring_size_ = 0;
+        cq_ring_ = nullptr;
+        cq_ring_size_ = 0;
+        sqes_ = nullptr;
+        sqes_size_ = 0;
+    }
+
+    void destroy() {
+        if(sqes_) munmap(sqes_, sqes_size_);
+        if(cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if(sq_ring_) munmap(sq_ring_, sq_ring_size_);
+        if(ring_fd_ >= 0) ::close(ring_fd_);
+        reset();
+    }
+
+    bool is_registered(void const* p, size_t const num) const {
+        auto const* b = (unsigned char const*)buf_;
+        auto const* q = (unsigned char const*)p;
+        return buf_ && q >= b && q + num <= b + bufsize_;
+    }
+
+    // prepares the next submission queue entry for the given operation
+    io_uring_sqe* prepare(uint8_t const opcode, void const* addr, uint32_t const len) {
+        uint32_t const tail = *sq_tail_;
+        uint32_t const idx = tail & *sq_mask_;
+
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fixed_file_ ? 0 : fd_;
+        sqe->flags = fixed_file_ ? IOSQE_FIXED_FILE : 0;
+        sqe->off = CURRENT_POS;
+        sqe->addr = (uint64_t)addr;
+        sqe->len = len;
+
+        sq_array_[idx] = idx;
+        store_release(sq_tail_, tail + 1);
+        return sqe;
+    }
+
+    // submits all prepared entries and waits for the completion of one, returning its result
+    ssize_t submit_and_wait() {
+        while(true) {
+            uint32_t const head = *cq_head_;
+            if(head != load_acquire(cq_tail_)) {
+                int const res = cqes_[head & *cq_mask_].res;
+                store_release(cq_head_, head + 1);
+                return res;
+            }
+
+            uint32_t const to_submit = *sq_tail_ - load_acquire(sq_head_);
+            int const r = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(r < 0 && errno != EINTR) {
+                return -errno;
+            }
+        }
+    }
+
+    ssize_t rw(uint8_t const op, uint8_t const op_fixed, void const* p, size_t const num) {
+        // nb: the kernel limits a single request to less than 2 GiB, larger requests result in short reads or writes
+        uint32_t const len = (uint32_t)std::min(num, size_t(INT32_MAX) & ~size_t(4095));
+        if(is_registered(p, len)) {
+            prepare(op_fixed, p, len)->buf_index = 0;
+        } else {
+            prepare(op, p, len);
+        }
+        return submit_and_wait();
+    }
+
+public:
+    inline IoUring() {
+        reset();
+    }
+
+    inline ~IoUring() {
+        destroy();
+    }
+
+    IoUring(IoUring const&) = delete;
+    IoUring& operator=(IoUring const&) = delete;
+
+    inline IoUring(IoUring&& other) : IoUring() {
+        *this = std::move(other);
+    }
+
+    inline IoUring& operator=(IoUring&& other) {
+        destroy();
+        std::memcpy((void*)this, (void const*)&other, sizeof(IoUring));
+        other.reset();
+        return *this;
+    }
+
+    /**
+     * \brief Attempts to set up the ring for the given file
+     * 
+     * This fails if the kernel does not support io_uring or does not allow using it, or if it lacks support for using the current file position.
+     * Registering the file and the buffer are optional and failures to do so are silently ignored.
+     * 
+     * \param fd the file descriptor
+     * \param buf the I/O buffer to register, may be \c nullptr
+     * \param bufsize the size of the I/O buffer
+     * \return true if the ring is ready for use
+     * \return false if the ring could not be set up
+     */
+    inline bool init(int const fd, void* buf = nullptr, size_t const bufsize = 0) {
+        destroy();
+        if(fd < 0) return false;
+
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = syscall(__NR_io_uring_setup, 2, &p);
+        if(ring_fd_ < 0) {
+            reset();
+            return false;
+        }
+
+        if(!(p.features & IORING_FEAT_RW_CUR_POS)) {
+            destroy();
+            return false;
+        }
+
+        // map rings
+        sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool const single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single_mmap) {
+            sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            cq_ring_size_ = sq_ring_size_;
+        }
+
+        void* sq = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if(sq == MAP_FAILED) {
+            destroy();
+            return false;
+        }
+        sq_ring_ = sq;
+
+        if(single_mmap) {
+            cq_ring_ = sq_ring_;
+        } else {
+            void* cq = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if(cq == MAP_FAILED) {
+                destroy();
+                return false;
+            }
+            cq_ring_ = cq;
+        }
+
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if(sqes == MAP_FAILED) {
+            destroy();
+            return false;
+        }
+        sqes_ = (io_uring_sqe*)sqes;
+
+        auto* sqb = (unsigned char*)sq_ring_;
+        sq_head_ = (uint32_t*)(sqb + p.sq_off.head);
+        sq_tail_ = (uint32_t*)(sqb + p.sq_off.tail);
+        sq_mask_ = (uint32_t*)(sqb + p.sq_off.ring_mask);
+        sq_array_ = (uint32_t*)(sqb + p.sq_off.array);
+
+        auto* cqb = (unsigned char*)cq_ring_;
+        cq_head_ = (uint32_t*)(cqb + p.cq_off.head);
+        cq_tail_ = (uint32_t*)(cqb + p.cq_off.tail);
+        cq_mask_ = (uint32_t*)(cqb + p.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe*)(cqb + p.cq_off.cqes);
+
+        // register file and buffer
+        fd_ = fd;
+        fixed_file_ = (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES, &fd_, 1) == 0);
+
+        if(buf && bufsize) {
+            iovec iov;
+            iov.iov_base = buf;
+            iov.iov_len = bufsize;
+            if(syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, &iov, 1) == 0) {
+                buf_ = buf;
+                bufsize_ = bufsize;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * \brief Tests whether the ring has been set up successfully
+     * 
+     * \return true if the ring can be used
+     * \return false otherwise
+     */
+    inline bool valid() const { return ring_fd_ >= 0; }
+
+    /**
+     * \brief Reads from the file at the current file position, like `read`
+     * 
+     * \param outp the output buffer
+     * \param num the number of bytes to read
+     * \return the number of bytes read, or the negated error code in case of an error
+     */
+    inline ssize_t read(void* outp, size_t const num) {
+        return rw(IORING_OP_READ, IORING_OP_READ_FIXED, outp, num);
+    }
+
+    /**
+     * \brief Writes to the file at the current file position, like `write`
+     * 
+     * \param inp the input buffer
+     * \param num the number of bytes to write
+     * \return the number of bytes written, or the negated error code in case of an error
+     */
+    inline ssize_t write(void const* inp, size_t const num) {
+        return rw(IORING_OP_WRITE, IORING_OP_WRITE_FIXED, inp, num);
+    }
+
+    /**
+     * \brief Reads into multiple buffers from the file at the current file position, like `readv`
+     * 
+     * \param iov the I/O vectors
+     * \param iovcnt the number of I/O vectors
+     * \return the number of bytes read, or the negated error code in case of an error
+     */
+    inline ssize_t readv(iovec const* iov, int const iovcnt) {
+        prepare(IORING_OP_READV, iov, iovcnt);
+        return submit_and_wait();
+    }
+
+    /**
+     * \brief Writes multiple buffers to the file at the current file position, like `writev`
+     * 
+     * \param iov the I/O vectors
+     * \param iovcnt the number of I/O vectors
+     * \return the number of bytes written, or the negated error code in case of an error
+     */
+    inline ssize_t writev(iovec const* iov, int const iovcnt) {
+        prepare(IORING_OP_WRITEV, iov, iovcnt);
+        return submit_and_wait();
+    }
+};
+
+/**
+ * \brief An \ref IoUring that is only set up once a number of I/O operations have been requested
+ * 
+ * Setting up a ring costs several system calls and memory mappings, whereas each operation is still submitted using one system call.
+ * For short-lived streams that issue only a few operations, this makes the ring slower than the plain system calls.
+ * This wrapper therefore defers setting up the ring until \ref get has been called a number of times; until then and in case setting up the ring fails, it reports no ring and the caller is expected to use the plain system calls.
+ */
+class LazyIoUring {
+public:
+    /**
+     * \brief The default number of I/O operations after which the ring is set up
+     */
+    static constexpr uint32_t DEFAULT_SETUP_DELAY = 16;
+
+private:
+    IoUring ring_;
+    int fd_;
+    void* buf_;
+    size_t bufsize_;
+    uint32_t countdown_; // number of operations until the ring is set up, zero if setup has been attempted or the ring is disarmed
+
+public:
+    inline LazyIoUring() : fd_(-1), buf_(nullptr), bufsize_(0), countdown_(0) {}
+
+    LazyIoUring(LazyIoUring const&) = delete;
+    LazyIoUring& operator=(LazyIoUring const&) = delete;
+    LazyIoUring(LazyIoUring&&) = default;
+
+    inline LazyIoUring& operator=(LazyIoUring&& other) {
+        ring_ = std::move(other.ring_);
+        fd_ = other.fd_;
+        buf_ = other.buf_;
+        bufsize_ = other.bufsize_;
+        countdown_ = std::exchange(other.countdown_, 0);
+        return *this;
+    }
+
+    /**
+     * \brief Prepares setting up the ring for the given file with the given arguments for \ref IoUring::init
+     * 
+     * \param fd the file descriptor
+     * \param buf the I/O buffer to register, may be \c nullptr
+     * \param bufsize the size of the I/O buffer
+     * \param delay the number of calls to \ref get after which the ring is set up
+     */
+    inline void arm(int const fd, void* buf = nullptr, size_t const bufsize = 0, uint32_t const delay = DEFAULT_SETUP_DELAY) {
+        ring_ = IoUring();
+        fd_ = fd;
+        buf_ = buf;
+        bufsize_ = bufsize;
+        countdown_ = std::max(delay, uint32_t(1));
+    }
+
+    /**
+     * \brief Provides the ring for the next I/O operation, setting it up if this is the operation it has been deferred to
+     * 
+     * \return the ring, or \c nullptr if the ring has not been set up (yet) and the plain system calls should be used
+     */
+    inline IoUring* get() {
+        if(countdown_) [[unlikely]] {
+            if(--countdown_ == 0) {
+                ring_.init(fd_, buf_, bufsize_); // nb: if this fails, the ring remains invalid for good
+            }
+        }
+        return ring_.valid() ? &ring_ : nullptr;
+    }
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,398 @@
+/**
+ * parallel_file_reader.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_PARALLEL_FILE_READER_HPP
+#define _IOPP_PARALLEL_FILE_READER_HPP
+
+#include <algorithm>
+#include <concepts>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "file_input_stream.hpp"
+#include "os/posix.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace iopp {
+
+namespace detail {
+
+// searches a file for a delimiter byte using a small scratch buffer on a single file descriptor
+class DelimScanner {
+private:
+    static constexpr size_t SCAN_BUFSIZE = 16 * 1024;
+
+    #ifdef IOPP_POSIX
+    int fd_;
+    #else
+    std::ifstream fstream_;
+    #endif
+
+    char buf_[SCAN_BUFSIZE];
+
+    // reads up to num bytes at the given file position into the scratch buffer, returning the number of bytes read
+    inline size_t read(size_t const pos, size_t const num) {
+        #ifdef IOPP_POSIX
+        while(true) {
+            auto const n = ::pread(fd_, buf_, num, pos);
+            if(n >= 0) [[likely]] return n;
+            if(errno != EINTR) return 0; // error
+        }
+        #else
+        fstream_.clear();
+        fstream_.seekg(pos);
+        fstream_.read(buf_, num);
+        return fstream_.gcount();
+        #endif
+    }
+
+public:
+    inline DelimScanner(std::filesystem::path const& path) {
+        #ifdef IOPP_POSIX
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        #else
+        fstream_ = std::ifstream(path, std::ios::in | std::ios::binary);
+        #endif
+    }
+
+    inline ~DelimScanner() {
+        #ifdef IOPP_POSIX
+        if(fd_ >= 0) ::close(fd_);
+        #endif
+    }
+
+    DelimScanner(DelimScanner const&) = delete;
+    DelimScanner& operator=(DelimScanner const&) = delete;
+
+    // finds the position right after the first occurrence of the delimiter in [pos, limit), or SIZE_MAX if there is none
+    inline size_t find(size_t pos, size_t const limit, char const delim) {
+        while(pos < limit) {
+            size_t const n = read(pos, std::min(limit - pos, SCAN_BUFSIZE));
+            if(n == 0) break; // EOF or error
+
+            auto const* found = (char const*)std::memchr(buf_, delim, n);
+            if(found) return pos + (found - buf_) + 1;
+            pos += n;
+        }
+        return SIZE_MAX;
+    }
+};
+
+}
+
+/**
+ * \brief Splits a range of a file into slices that can be processed independently, e.g., by multiple threads
+ * 
+ * The slices are contiguous, disjoint and cover the entire range.
+ * Optionally, slice boundaries can be aligned to a delimiter byte, such that each slice (except possibly the last) ends with the delimiter.
+ * This way, text records (e.g., lines) are never split between two slices; however, slices may then be empty.
+ * 
+ * Each slice can be read using its own \ref FileInputStream obtained via \ref open , or all slices can be processed concurrently using \ref for_each .
+ */
+class ParallelFileReader {
+private:
+    std::filesystem::path path_;
+    std::vector<size_t> bounds_; // slice i is [bounds_[i], bounds_[i+1])
+
+    void split(size_t const begin, size_t const end, size_t num_slices, int const delim) {
+        if(num_slices == 0) num_slices = std::max(1U, std::thread::hardware_concurrency());
+
+        size_t const size = end - begin;
+        auto nominal = [&](size_t const i){ return begin + (size / num_slices) * i + std::min(i, size % num_slices); };
+
+        bounds_.resize(num_slices + 1);
+        bounds_[0] = begin;
+        bounds_[num_slices] = end;
+
+        if(delim == std::char_traits<char>::eof()) {
+            for(size_t i = 1; i < num_slices; i++) bounds_[i] = nominal(i);
+        } else {
+            // the slice must end with the delimiter, so we search from the byte preceding the nominal boundary on
+            // the search stops where the next boundary's search starts, so every byte is scanned at most once
+            // if the delimiter does not occur there, the boundary collapses onto the previous one, leaving an empty slice
+            detail::DelimScanner scanner(path_);
+            for(size_t i = 1; i < num_slices; i++) {
+                size_t const b = nominal(i);
+                size_t const found = (b > begin) ? scanner.find(b - 1, nominal(i + 1) - 1, (char)delim) : SIZE_MAX;
+                bounds_[i] = (found != SIZE_MAX) ? found : bounds_[i - 1];
+            }
+        }
+    }
+
+public:
+    ParallelFileReader() {}
+
+    /**
+     * \brief Splits a range of the specified file into slices
+     * 
+     * The slices are initially of roughly equal size.
+     * If a delimiter is given, each boundary is then moved forward to the position right after the next occurrence of the delimiter.
+     * In case there is none before the next boundary, the boundary collapses onto the previous one, such that the slice becomes empty.
+     * 
+     * \param path the path to the file
+     * \param num_slices the number of slices; if zero, the number of hardware threads is used
+     * \param begin the position of the first byte of the range
+     * \param end the position of the last byte of the range
+     * \param delim the delimiter byte, or \c std::char_traits<char>::eof() to not align the slices
+     */
+    inline ParallelFileReader(std::filesystem::path const& path, size_t const num_slices = 0, size_t const begin = 0, size_t const end = SIZE_MAX, int const delim = std::char_traits<char>::eof()) : path_(path) {
+        if(!std::filesystem::exists(path)) {
+            throw std::logic_error("file does not exist: " + path.string());
+        }
+
+        size_t const actual_end = std::min(end, (size_t)std::filesystem::file_size(path));
+        split(std::min(begin, actual_end), actual_end, num_slices, delim);
+    }
+
+    /**
+     * \brief Reports the number of slices
+     * 
+     * \return the number of slices
+     */
+    inline size_t size() const { return bounds_.empty() ? 0 : bounds_.size() - 1; }
+
+    /**
+     * \brief Reports the file range covered by a slice
+     * 
+     * \param i the slice number
+     * \return the positions of the first byte and the byte after the last byte of the slice in the file
+     */
+    inline std::pair<size_t, size_t> range(size_t const i) const { return { bounds_[i], bounds_[i + 1] }; }
+
+    /**
+     * \brief Opens an input stream over a slice
+     * 
+     * The stream is independent of any other, so it can be used by a different thread than other slices' streams.
+     * 
+     * \param i the slice number
+     * \param bufsize the size of the stream's read buffer, or \ref BUFSIZE_AUTO to choose it automatically
+     * \param cache_mode determines how the stream interacts with the page cache
+     * \return an input stream over the slice
+     */
+    inline FileInputStream open(size_t const i, size_t const bufsize = BUFSIZE_AUTO, CacheMode const cache_mode = CacheMode::normal) const {
+        auto const [b, e] = range(i);
+        return FileInputStream(path_, b, e, bufsize, cache_mode);
+    }
+
+    /**
+     * \brief Processes all slices concurrently, using one thread per slice
+     * 
+     * The function is called with the slice number and an input stream over the slice.
+     * If any call throws an exception, it is rethrown after all threads have finished; if multiple calls throw, the exception of the lowest slice number is rethrown.
+     * 
+     * \tparam F the function type
+     * \param f the function to call for each slice
+     * \param bufsize the size of each stream's read buffer, or \ref BUFSIZE_AUTO to choose it automatically
+     * \param cache_mode determines how the streams interact with the page cache
+     */
+    template<typename F>
+    requires std::invocable<F&, size_t, FileInputStream&>
+    void for_each(F f, size_t const bufsize = BUFSIZE_AUTO, CacheMode const cache_mode = CacheMode::normal) const {
+        std::vector<std::exception_ptr> errors(size());
+        std::vector<std::thread> threads;
+        threads.reserve(size());
+        for(size_t i = 0; i < size(); i++) {
+            threads.emplace_back([&, i](){
+                try {
+                    auto in = open(i, bufsize, cache_mode);
+                    f(i, in);
+                } catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for(auto& t : threads) t.join();
+
+        // rethrow the first exception, if any
+        for(auto& e : errors) {
+            if(e) std::rethrow_exception(e);
+        }
+    }
+};
+
+/**
+ * \brief Loads a range of the specified file into a caller-provided buffer using multiple threads
+ * 
+ * The range is split into contiguous parts, which are read concurrently directly into their final location in the buffer.
+ * The boundaries between parts are aligned to 4096 bytes in the file.
+ * On POSIX systems, this is done using `pread` on a single file descriptor.
+ * The buffer is not initialized beforehand.
+ * 
+ * \param path the file path
+ * \param out the output buffer
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param num_threads the number of threads to use; if zero, the number of hardware threads is used, but at most one per MiB to load
+ * \return the number of characters loaded
+ */
+inline size_t load_file_parallel(std::filesystem::path const& path, std::span<char> out, size_t const begin = 0, size_t const end = SIZE_MAX, size_t num_threads = 0) {
+    constexpr size_t MIN_SLICE = 1024 * 1024; // for the automatic choice of the number of threads
+    constexpr size_t ALIGN = 4096; // read ranges are aligned to this for efficiency
+
+    size_t const file_size = std::filesystem::file_size(path);
+    size_t const actual_end = std::min(end, file_size);
+    size_t const actual_begin = std::min(begin, actual_end);
+    size_t const size = std::min(out.size(), actual_end - actual_begin);
+    if(size == 0) return 0;
+
+    if(num_threads == 0) num_threads = std::min(size_t(std::max(1U, std::thread::hardware_concurrency())), (size + MIN_SLICE - 1) / MIN_SLICE);
+    num_threads = std::max(size_t(1), std::min(num_threads, (size + ALIGN - 1) / ALIGN));
+
+    // parts are multiples of ALIGN and their boundaries are aligned to ALIGN in the file
+    // the first part additionally covers the unaligned head of the range, the last part covers the remainder
+    size_t const slice = (((size + num_threads - 1) / num_threads + ALIGN - 1) / ALIGN) * ALIGN;
+    size_t const head = (ALIGN - actual_begin % ALIGN) % ALIGN;
+    auto part_begin = [&](size_t const i){ return (i == 0) ? size_t(0) : std::min(head + i * slice, size); };
+    auto part_end = [&](size_t const i){ return (i + 1 == num_threads) ? size : part_begin(i + 1); };
+
+    std::vector<size_t> num_read(num_threads, 0);
+
+    #ifdef IOPP_POSIX
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return 0;
+    #endif
+
+    auto load_slice = [&](size_t const i){
+        size_t const offs = part_begin(i);
+        size_t const num = part_end(i) - offs;
+        if(num == 0) return;
+
+        #ifdef IOPP_POSIX
+        size_t done = 0;
+        while(done < num) {
+            auto const n = ::pread(fd, out.data() + offs + done, num - done, actual_begin + offs + done);
+            if(n > 0) [[likely]] {
+                done += n;
+            } else if(n < 0 && errno == EINTR) {
+                continue; // interrupted, try again
+            } else {
+                break; // EOF or error
+            }
+        }
+        num_read[i] = done;
+        #else
+        FileInputStream fin(path, actual_begin + offs, actual_begin + offs + num, 4096);
+        fin.read(out.data() + offs, num);
+        num_read[i] = fin.gcount();
+        #endif
+    };
+
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for(size_t i = 1; i < num_threads; i++) threads.emplace_back(load_slice, i);
+        load_slice(0);
+        for(auto& t : threads) t.join();
+    }
+
+    #ifdef IOPP_POSIX
+    ::close(fd);
+    #endif
+
+    // report the number of characters loaded contiguously from the beginning
+    size_t total = 0;
+    for(size_t i = 0; i < num_threads; i++) {
+        total += num_read[i];
+        if(num_read[i] < part_end(i) - part_begin(i)) break;
+    }
+    return total;
+}
+
+/**
+ * \brief Loads a range of the specified file into a string using multiple threads
+ * 
+ * This is the parallel counterpart of \ref load_file(std::filesystem::path const&, std::string&, size_t, size_t, LoadMethod) .
+ * 
+ * \param path the file path
+ * \param out the output string, whose previous contents are discarded
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param num_threads the number of threads to use; if zero, the number of hardware threads is used, but at most one per MiB to load
+ * \return the number of characters loaded
+ */
+inline size_t load_file_parallel(std::filesystem::path const& path, std::string& out, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const num_threads = 0) {
+    size_t const file_size = std::filesystem::file_size(path);
+    size_t const actual_end = std::min(end, file_size);
+    size_t const size = actual_end - std::min(begin, actual_end);
+
+    #ifdef __cpp_lib_string_resize_and_overwrite
+    out.resize_and_overwrite(size, [&](char* p, size_t const n){
+        return load_file_parallel(path, std::span<char>(p, n), begin, end, num_threads);
+    });
+    #else
+    out.clear();
+    out.resize(size);
+    out.resize(load_file_parallel(path, std::span<char>(out.data(), size), begin, end, num_threads));
+    #endif
+    return out.size();
+}
+
+/**
+ * \brief Loads a range of the specified file into a vector using multiple threads
+ * 
+ * This is the parallel counterpart of \ref load_file(std::filesystem::path const&, std::vector<T, Alloc>&, size_t, size_t, LoadMethod) .
+ * 
+ * \tparam T the item type, which must be trivially copyable
+ * \tparam Alloc the vector's allocator type
+ * \param path the file path
+ * \param out the output vector, whose previous contents are discarded
+ * \param begin the position of the first byte in the file to load
+ * \param end the position of the last byte in the file to load
+ * \param num_threads the number of threads to use; if zero, the number of hardware threads is used, but at most one per MiB to load
+ * \return the number of items loaded
+ */
+template<typename T, typename Alloc>
+requires std::is_trivially_copyable_v<T>
+inline size_t load_file_parallel(std::filesystem::path const& path, std::vector<T, Alloc>& out, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const num_threads = 0) {
+    size_t const file_size = std::filesystem::file_size(path);
+    size_t const actual_end = std::min(end, file_size);
+    size_t const num_items = (actual_end - std::min(begin, actual_end)) / sizeof(T);
+
+    out.clear();
+    out.resize(num_items);
+    size_t const num_read = load_file_parallel(path, std::span<char>((char*)out.data(), num_items * sizeof(T)), begin, end, num_threads);
+    out.resize(num_read / sizeof(T));
+    return out.size();
+}
+
+}
+
+#endif
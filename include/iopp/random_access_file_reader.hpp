@@ -0,0 +1,332 @@
+/**
+ * random_access_file_reader.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_RANDOM_ACCESS_FILE_READER_HPP
+#define _IOPP_RANDOM_ACCESS_FILE_READER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "os/posix.hpp"
+#include "util/aligned_buffer.hpp"
+
+#ifdef IOPP_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace iopp {
+
+/**
+ * \brief Thread-safe reader for random access to a file
+ * 
+ * In contrast to the file input streams, the reader has no notion of a current position.
+ * Instead, every read specifies the offset to read from via \ref read_at .
+ * On POSIX systems, reads are done using `pread` on a single file descriptor, so any number of threads can read from the same reader at the same time.
+ * Otherwise, reads are serialized.
+ * 
+ * Optionally, the reader keeps a small cache of recently read blocks, which is managed using a least-recently-used (LRU) strategy.
+ * This benefits repeated small lookups into the same region of the file.
+ * Reads that span more blocks than the cache can hold bypass the cache.
+ */
+class RandomAccessFileReader {
+public:
+    /**
+     * \brief The default size of cached blocks
+     */
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+
+private:
+    // the block cache, shared by all threads
+    struct BlockCache {
+        struct Slot {
+            size_t block;                    // the cached block number
+            size_t size;                     // the number of valid bytes in the block
+            std::list<size_t>::iterator lru; // the slot's entry in the LRU list
+        };
+
+        std::mutex mutex;
+        AlignedBuffer data;                     // the slots' memory
+        std::vector<Slot> slots;
+        std::vector<size_t> free;               // slots not currently in use
+        std::list<size_t> lru;                  // cached slots, most recently used first
+        std::unordered_map<size_t, size_t> map; // maps block numbers to cached slots
+    };
+
+    size_t begin_;
+    size_t end_;
+    size_t block_size_;
+    std::unique_ptr<BlockCache> cache_;
+
+#ifdef IOPP_POSIX
+    int fd_;
+#else
+    struct Stream {
+        std::mutex mutex;
+        std::ifstream fstream;
+    };
+    std::unique_ptr<Stream> stream_;
+#endif
+
+    // reads from the given absolute file position, bypassing the cache
+    inline size_t pread_fully(char* outp, size_t const num, size_t const pos) const {
+        #ifdef IOPP_POSIX
+        size_t num_read = 0;
+        while(num_read < num) {
+            auto const n = ::pread(fd_, outp + num_read, num - num_read, pos + num_read);
+            if(n > 0) [[likely]] {
+                num_read += n;
+            } else if(n < 0 && errno == EINTR) {
+                continue; // interrupted, try again
+            } else {
+                break; // EOF or error, maybe throw?
+            }
+        }
+        return num_read;
+        #else
+        std::unique_lock lock(stream_->mutex);
+        stream_->fstream.clear();
+        stream_->fstream.seekg(pos, std::ios::beg);
+        stream_->fstream.read(outp, num);
+        return stream_->fstream.gcount();
+        #endif
+    }
+
+    // copies a part of a block to the output, loading the block into the cache if needed
+    // the part must not exceed the end of the readable range
+    inline size_t read_block(size_t const block, size_t const offs, char* outp, size_t const num) const {
+        auto& c = *cache_;
+        size_t const block_pos = block * block_size_;
+
+        std::unique_lock lock(c.mutex);
+        auto it = c.map.find(block);
+        if(it != c.map.end()) {
+            // cache hit
+            auto& slot = c.slots[it->second];
+            c.lru.splice(c.lru.begin(), c.lru, slot.lru);
+
+            size_t const n = (offs < slot.size) ? std::min(num, slot.size - offs) : 0;
+            std::memcpy(outp, c.data.get() + it->second * block_size_ + offs, n);
+            return n;
+        }
+
+        // cache miss, acquire a slot, evicting the least recently used block if necessary
+        size_t s;
+        if(!c.free.empty()) {
+            s = c.free.back();
+            c.free.pop_back();
+        } else if(!c.lru.empty()) {
+            s = c.lru.back();
+            c.lru.pop_back();
+            c.map.erase(c.slots[s].block);
+        } else {
+            // all slots are currently being loaded by other threads
+            lock.unlock();
+            return pread_fully(outp, num, block_pos + offs);
+        }
+
+        // load the block without holding the lock
+        // nb: the slot is neither free nor in the LRU list, so no other thread will touch it
+        lock.unlock();
+        char* const slot_data = (char*)c.data.get() + s * block_size_;
+        size_t const size = pread_fully(slot_data, std::min(block_size_, end_ - std::min(end_, block_pos)), block_pos);
+        size_t const n = (offs < size) ? std::min(num, size - offs) : 0;
+        std::memcpy(outp, slot_data + offs, n);
+        lock.lock();
+
+        if(c.map.contains(block)) {
+            // another thread has loaded the same block in the meantime
+            c.free.push_back(s);
+        } else {
+            c.lru.push_front(s);
+            c.slots[s] = { block, size, c.lru.begin() };
+            c.map.emplace(block, s);
+        }
+        return n;
+    }
+
+public:
+    inline RandomAccessFileReader() : begin_(0), end_(0), block_size_(DEFAULT_BLOCK_SIZE) {
+        #ifdef IOPP_POSIX
+        fd_ = -1;
+        #endif
+    }
+
+    /**
+     * \brief Opens the specified file for random access
+     * 
+     * \param path the path to the file to read
+     * \param begin the position of the first byte to read; this will be considered offset zero
+     * \param end the position of the last byte to read; reads will stop at this position, even if the file is larger
+     * \param cache_blocks the number of blocks to cache, or zero to disable the cache
+     * \param block_size the size of cached blocks; blocks are aligned to multiples of this size in the file
+     */
+    inline RandomAccessFileReader(std::filesystem::path const& path, size_t const begin = 0, size_t const end = SIZE_MAX, size_t const cache_blocks = 0, size_t const block_size = DEFAULT_BLOCK_SIZE)
+        : RandomAccessFileReader()
+    {
+        if(!std::filesystem::exists(path)) {
+            throw std::logic_error("file does not exist: " + path.string());
+        }
+
+        end_ = std::min(end, (size_t)std::filesystem::file_size(path));
+        begin_ = std::min(begin, end_);
+        block_size_ = std::max(block_size, size_t(1));
+
+        #ifdef IOPP_POSIX
+        fd_ = open(path.c_str(), O_RDONLY);
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM); // we expect random data access
+        #else
+        stream_ = std::make_unique<Stream>();
+        stream_->fstream = std::ifstream(path, std::ios::in | std::ios::binary);
+        #endif
+
+        if(cache_blocks) {
+            cache_ = std::make_unique<BlockCache>();
+            cache_->data = make_aligned_buffer(cache_blocks * block_size_);
+            cache_->slots.resize(cache_blocks);
+            for(size_t i = 0; i < cache_blocks; i++) cache_->free.push_back(cache_blocks - 1 - i);
+        }
+    }
+
+    inline ~RandomAccessFileReader() {
+        #ifdef IOPP_POSIX
+        if(fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        #endif
+    }
+
+    RandomAccessFileReader(RandomAccessFileReader const&) = delete;
+    RandomAccessFileReader& operator=(RandomAccessFileReader const&) = delete;
+
+    inline RandomAccessFileReader(RandomAccessFileReader&& other) : RandomAccessFileReader() {
+        *this = std::move(other);
+    }
+
+    inline RandomAccessFileReader& operator=(RandomAccessFileReader&& other) {
+        begin_ = other.begin_;
+        end_ = other.end_;
+        block_size_ = other.block_size_;
+        cache_ = std::move(other.cache_);
+
+        #ifdef IOPP_POSIX
+        if(fd_ >= 0) ::close(fd_);
+        fd_ = other.fd_;
+        other.fd_ = -1;
+        #else
+        stream_ = std::move(other.stream_);
+        #endif
+
+        other.begin_ = 0;
+        other.end_ = 0;
+        return *this;
+    }
+
+    /**
+     * \brief Reads characters from the given offset
+     * 
+     * This function may be called by multiple threads concurrently.
+     * 
+     * \param offs the offset to read from, relative to the beginning of the readable range
+     * \param outp the output buffer
+     * \param num the number of characters to read
+     * \return the number of characters read, which is less than requested only if the end of the readable range is reached or an error occurred
+     */
+    inline size_t read_at(size_t const offs, char* outp, size_t const num) const {
+        if(offs >= size()) return 0;
+
+        size_t const pos = begin_ + offs;
+        size_t const end = pos + std::min(num, size() - offs);
+        size_t const first_block = pos / block_size_;
+        size_t const last_block = (end - 1) / block_size_;
+
+        if(!cache_ || last_block - first_block >= cache_->slots.size()) {
+            // read directly
+            return pread_fully(outp, end - pos, pos);
+        }
+
+        // read block by block through the cache
+        size_t num_read = 0;
+        for(size_t b = first_block; b <= last_block; b++) {
+            size_t const block_offs = (b == first_block) ? pos % block_size_ : 0;
+            size_t const want = std::min(block_size_ - block_offs, end - (pos + num_read));
+            size_t const n = read_block(b, block_offs, outp + num_read, want);
+            num_read += n;
+            if(n < want) break; // EOF or error
+        }
+        return num_read;
+    }
+
+    /**
+     * \brief Reports the size of the readable range
+     * 
+     * \return the number of readable characters
+     */
+    inline size_t size() const { return end_ - begin_; }
+
+    /**
+     * \brief Reports the size of cached blocks
+     * 
+     * \return the block size
+     */
+    inline size_t block_size() const { return block_size_; }
+
+    /**
+     * \brief Reports the maximum number of cached blocks
+     * 
+     * \return the maximum number of cached blocks, or zero if the cache is disabled
+     */
+    inline size_t cache_capacity() const { return cache_ ? cache_->slots.size() : 0; }
+
+    /**
+     * \brief Evicts all blocks from the cache
+     */
+    inline void clear_cache() {
+        if(cache_) {
+            std::unique_lock lock(cache_->mutex);
+            for(size_t s : cache_->lru) cache_->free.push_back(s);
+            cache_->lru.clear();
+            cache_->map.clear();
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * segmented_bitwise_io.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_SEGMENTED_BITWISE_IO_HPP
+#define _IOPP_SEGMENTED_BITWISE_IO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "file_output_stream.hpp"
+#include "io_vec.hpp"
+#include "memory_mapped_file.hpp"
+#include "util/bit_packer.hpp"
+#include "util/bit_reader.hpp"
+#include "util/bit_unpacker.hpp"
+#include "util/bits.hpp"
+#include "util/char_packer.hpp"
+#include "util/pack_word.hpp"
+
+namespace iopp {
+
+/**
+ * \brief The bit sink type that segments are encoded with by \ref write_segmented
+ */
+using SegmentBitSink = BitPacker<std::back_insert_iterator<std::vector<PackWord>>>;
+
+/**
+ * \brief The bit source type that segments are decoded with by \ref SegmentedBitReader
+ */
+using SegmentBitSource = BitUnpacker<CharPacker<char const*>>;
+
+namespace detail {
+
+// identifies the segmented bitwise format ("IOPPSEG1" in ASCII)
+constexpr uint64_t SEGMENTED_MAGIC = 0x494F505053454731ULL;
+
+// header integers are stored with the most significant byte first, like pack words
+
+inline void store_segmented_word(char* p, uint64_t x) {
+    if constexpr(std::endian::native == std::endian::little) x = byteswap(x);
+    std::memcpy(p, &x, sizeof(x));
+}
+
+inline uint64_t load_segmented_word(char const* p) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    if constexpr(std::endian::native == std::endian::little) x = byteswap(x);
+    return x;
+}
+
+// runs task(i) for every i in [0, num_tasks) using at most one thread per hardware thread
+// exceptions thrown by tasks are rethrown after all threads have finished, the one of the lowest task number first
+template<typename Task>
+inline void run_concurrently(size_t const num_tasks, Task task) {
+    std::vector<std::exception_ptr> errors(num_tasks);
+    std::atomic<size_t> next = 0;
+    auto work = [&](){
+        for(size_t i = next++; i < num_tasks; i = next++) {
+            try {
+                task(i);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    size_t const num_threads = std::min(num_tasks, size_t(std::max(1U, std::thread::hardware_concurrency())));
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads);
+        for(size_t t = 1; t < num_threads; t++) threads.emplace_back(work);
+        work(); // nb: the calling thread participates
+        for(auto& t : threads) t.join();
+    }
+
+    for(auto& e : errors) {
+        if(e) std::rethrow_exception(e);
+    }
+}
+
+}
+
+/**
+ * \brief Encodes a bit stream in independent segments using multiple threads and writes them to a file
+ * 
+ * Each segment is encoded using its own \ref BitPacker , which is passed to the encoder function along with the segment number.
+ * The segments are distributed among at most as many threads as there are hardware threads.
+ * If the encoder throws an exception, it is rethrown once all threads have finished and no file is written.
+ * The segments are buffered in memory and, once all are complete, written to the file following a header that records each segment's offset and length in bits.
+ * This allows for decoding the segments independently, e.g., in parallel using a \ref SegmentedBitReader .
+ * 
+ * The file layout is as follows, in 64-bit words with the most significant byte first:
+ * * the magic number `IOPPSEG1` followed by the number of segments `n`,
+ * * for each segment, its byte offset in the file and its number of bits, not including the finalizer, and
+ * * the segments, each consisting of a whole number of serialized pack words as written by \ref bitwise_output_to .
+ * 
+ * \tparam Encoder the encoder function type
+ * \param path the path to the output file; if the file already exists, it will be overwritten
+ * \param num_segments the number of segments
+ * \param encode the function called concurrently for each segment with the segment number and a \ref SegmentBitSink
+ */
+template<typename Encoder>
+requires std::invocable<Encoder&, size_t, SegmentBitSink&>
+void write_segmented(std::filesystem::path const& path, size_t const num_segments, Encoder encode) {
+    std::vector<std::vector<PackWord>> segments(num_segments);
+    std::vector<size_t> num_bits(num_segments);
+
+    auto encode_segment = [&](size_t const i){
+        {
+            SegmentBitSink sink(std::back_inserter(segments[i]));
+            encode(i, sink);
+            num_bits[i] = sink.num_bits_written();
+        } // nb: the sink writes the finalizer when destroyed
+
+        // serialize the pack words in place
+        for(auto& w : segments[i]) store_pack_word((char*)&w, w);
+    };
+
+    detail::run_concurrently(num_segments, encode_segment);
+
+    // build the header
+    constexpr size_t W = sizeof(uint64_t);
+    std::vector<char> header((2 + 2 * num_segments) * W);
+    detail::store_segmented_word(header.data(), detail::SEGMENTED_MAGIC);
+    detail::store_segmented_word(header.data() + W, num_segments);
+
+    size_t offs = header.size();
+    for(size_t i = 0; i < num_segments; i++) {
+        detail::store_segmented_word(header.data() + (2 + 2 * i) * W, offs);
+        detail::store_segmented_word(header.data() + (3 + 2 * i) * W, num_bits[i]);
+        offs += segments[i].size() * sizeof(PackWord);
+    }
+
+    // write the header and segments without copying them
+    std::vector<IoVec> iov;
+    iov.reserve(num_segments + 1);
+    iov.push_back({ header.data(), header.size() });
+    for(auto& seg : segments) iov.push_back({ seg.data(), seg.size() * sizeof(PackWord) });
+
+    FileOutputStream out(path);
+    out.writev(iov);
+}
+
+/**
+ * \brief Reads a file written by \ref write_segmented
+ * 
+ * The file is memory-mapped, so segments are decoded straight from the mapped memory.
+ * Each segment can be read sequentially using a \ref BitUnpacker obtained via \ref open , or with random access using a \ref BitReader obtained via \ref reader .
+ * All segments can be decoded concurrently using \ref for_each .
+ */
+class SegmentedBitReader {
+private:
+    MemoryMappedFile mapping_;
+    std::vector<size_t> offsets_; // segment i occupies bytes [offsets_[i], offsets_[i+1])
+    std::vector<size_t> num_bits_;
+
+    inline char const* data() const { return (char const*)mapping_.data(); }
+
+public:
+    SegmentedBitReader() {}
+
+    /**
+     * \brief Opens the specified file and reads its header
+     * 
+     * A `std::runtime_error` is thrown if the file is not in the segmented bitwise format.
+     * 
+     * \param path the path to the file
+     */
+    inline SegmentedBitReader(std::filesystem::path const& path) {
+        if(!std::filesystem::exists(path)) {
+            throw std::logic_error("file does not exist: " + path.string());
+        }
+
+        constexpr size_t W = sizeof(uint64_t);
+        mapping_ = MemoryMappedFile(path);
+
+        size_t const size = mapping_.size();
+        if(size < 2 * W || detail::load_segmented_word(data()) != detail::SEGMENTED_MAGIC) {
+            throw std::runtime_error("not a segmented bit stream: " + path.string());
+        }
+
+        size_t const n = detail::load_segmented_word(data() + W);
+        if(n > (size / W - 2) / 2) {
+            throw std::runtime_error("truncated segmented bit stream: " + path.string());
+        }
+
+        offsets_.resize(n + 1);
+        num_bits_.resize(n);
+        for(size_t i = 0; i < n; i++) {
+            offsets_[i] = detail::load_segmented_word(data() + (2 + 2 * i) * W);
+            num_bits_[i] = detail::load_segmented_word(data() + (3 + 2 * i) * W);
+        }
+        offsets_[n] = size;
+
+        size_t const header_size = (2 + 2 * n) * W;
+        for(size_t i = 0; i < n; i++) {
+            if(offsets_[i] < header_size || offsets_[i] > offsets_[i + 1] || num_bits_[i] > (offsets_[i + 1] - offsets_[i]) * 8) {
+                throw std::runtime_error("corrupt segmented bit stream: " + path.string());
+            }
+        }
+    }
+
+    /**
+     * \brief Reports the number of segments
+     * 
+     * \return the number of segments
+     */
+    inline size_t size() const { return num_bits_.size(); }
+
+    /**
+     * \brief Reports the number of bits in a segment
+     * 
+     * \param i the segment number
+     * \return the number of bits encoded in the segment, not including the finalizer
+     */
+    inline size_t num_bits(size_t const i) const { return num_bits_[i]; }
+
+    /**
+     * \brief Provides the serialized pack words of a segment
+     * 
+     * \param i the segment number
+     * \return the characters of the segment
+     */
+    inline std::span<char const> segment(size_t const i) const {
+        return { data() + offsets_[i], offsets_[i + 1] - offsets_[i] };
+    }
+
+    /**
+     * \brief Opens a segment for sequential decoding
+     * 
+     * The returned bit unpacker is independent of any other, so it can be used by a different thread than other segments' unpackers.
+     * 
+     * \param i the segment number
+     * \return a bit unpacker over the segment
+     */
+    inline SegmentBitSource open(size_t const i) const {
+        auto const seg = segment(i);
+        return SegmentBitSource(CharPacker(seg.data(), seg.data() + seg.size()), {});
+    }
+
+    /**
+     * \brief Opens a segment for random access
+     * 
+     * \param i the segment number
+     * \return a bit reader over the segment
+     */
+    inline BitReader reader(size_t const i) const {
+        auto const seg = segment(i);
+        return BitReader(seg.data(), seg.data() + seg.size());
+    }
+
+    /**
+     * \brief Decodes all segments concurrently
+     * 
+     * The segments are distributed among at most as many threads as there are hardware threads.
+     * The function is called with the segment number and a bit unpacker over the segment.
+     * If any call throws an exception, it is rethrown after all threads have finished; if multiple calls throw, the exception of the lowest segment number is rethrown.
+     * 
+     * \tparam F the function type
+     * \param f the function to call for each segment
+     */
+    template<typename F>
+    requires std::invocable<F&, size_t, SegmentBitSource&>
+    void for_each(F f) const {
+        detail::run_concurrently(size(), [&](size_t const i){
+            auto src = open(i);
+            f(i, src);
+        });
+    }
+};
+
+}
+
+#endif
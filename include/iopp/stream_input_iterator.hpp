@@ -170,6 +170,30 @@ public:
         advance();
         return dead_end;
     }
+
+    /**
+     * \brief Reads multiple items at once
+     * 
+     * This is equivalent to dereferencing and advancing the iterator up to `num` times, but reads from the stream using its `read` function.
+     * If the underlying stream reports EOF, the iterator will enter EOF state.
+     * 
+     * \param outp the output buffer
+     * \param num the maximum number of items to read
+     * \return the number of items read, which is less than `num` only if EOF has been reached
+     */
+    size_t read(Char* outp, size_t const num) {
+        if(eof_ || num == 0) return 0;
+
+        *outp = current_;
+        size_t n = 1;
+        if(num > 1) {
+            stream_->read(outp + 1, num - 1);
+            n += stream_->gcount();
+        }
+
+        advance();
+        return n;
+    }
 };
 
 }
@@ -29,6 +29,7 @@
 #define _IOPP_STREAM_OUTPUT_ITERATOR_HPP
 
 #include "concepts.hpp"
+#include "util/write_range.hpp"
 
 namespace iopp {
 
@@ -38,6 +39,8 @@ namespace iopp {
  * This iterator writes any character it is assigned to (dereferenced or not) to the given output stream via the `put` function.
  * Incrementing an output stream iterator is a no-op.
  * 
+ * Writing characters one by one costs a `put` call each; to write a contiguous range of characters at once, use \ref write or \ref write_range instead of `std::copy`.
+ * 
  * Other than the standard library input stream iterators, this iterator has the weaker constraint where the stream has to be only \ref iopp::STLOutputStreamLike "STLOutputStreamLike".
  * This enables use of input streams that share a similar interface, but don't rely on virtual inheritance at their core.
  * 
@@ -74,6 +77,14 @@ public:
 
     void operator=(Char c) { stream_->put(c); }
 
+    /**
+     * \brief Writes multiple characters at once using the stream's `write` function
+     * 
+     * \param inp the input characters
+     * \param num the number of characters to write
+     */
+    void write(Char const* inp, size_t const num) { stream_->write(inp, num); }
+
     StreamOutputIterator& operator*() { return *this; }
     StreamOutputIterator& operator++(int) { return *this; }
     StreamOutputIterator& operator++() { return *this; }
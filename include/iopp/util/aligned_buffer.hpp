@@ -0,0 +1,80 @@
+/**
+ * util/aligned_buffer.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _IOPP_UTIL_ALIGNED_BUFFER_HPP
+#define _IOPP_UTIL_ALIGNED_BUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace iopp {
+
+/**
+ * \brief Deleter for buffers allocated with \ref make_aligned_buffer
+ * 
+ * If a release function is set, the buffer is handed to it instead of being deleted, e.g., in order to return it to a \ref BufferPool .
+ */
+struct AlignedBufferDeleter {
+    using ReleaseFunc = void (*)(void* ctx, unsigned char* p, size_t size, std::align_val_t align);
+
+    std::align_val_t align = std::align_val_t(alignof(std::max_align_t));
+    size_t size = 0;
+    ReleaseFunc release = nullptr;
+    void* ctx = nullptr;
+
+    void operator()(unsigned char* p) const {
+        if(release) {
+            release(ctx, p, size, align);
+        } else {
+            ::operator delete[](p, align);
+        }
+    }
+};
+
+/**
+ * \brief An uninitialized, aligned byte buffer
+ */
+using AlignedBuffer = std::unique_ptr<unsigned char[], AlignedBufferDeleter>;
+
+/**
+ * \brief Allocates an uninitialized byte buffer with the given alignment
+ * 
+ * \param size the size of the buffer
+ * \param align the alignment, which must be a power of two
+ * \return the allocated buffer
+ */
+inline AlignedBuffer make_aligned_buffer(size_t const size, size_t const align = alignof(std::max_align_t)) {
+    auto const a = std::align_val_t(std::max(align, alignof(std::max_align_t)));
+    return AlignedBuffer((unsigned char*)::operator new[](size, a), AlignedBufferDeleter { a, size });
+}
+
+}
+
+#endif
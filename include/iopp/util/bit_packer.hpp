@@ -28,8 +28,10 @@
 #ifndef _IOPP_UTIL_BIT_PACKER_HPP
 #define _IOPP_UTIL_BIT_PACKER_HPP
 
+#include <array>
 #include <bit>
 #include <cassert>
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
@@ -38,32 +40,55 @@
 
 #include "bits.hpp"
 #include "pack_word.hpp"
+#include "../instrumentation.hpp"
 
 namespace iopp {
 
+namespace detail {
+
+// determines the default pack word type for an output iterator
+// this is the word type of a CharUnpacker, or the value type of the container of an insert iterator, or otherwise PackWord
+template<typename Output>
+struct default_pack_word { using type = PackWord; };
+
+template<typename Output>
+requires requires { typename Output::word_type; }
+struct default_pack_word<Output> { using type = typename Output::word_type; };
+
+template<typename Output>
+requires (!requires { typename Output::word_type; }) && PackWordType<typename Output::container_type::value_type>
+struct default_pack_word<Output> { using type = typename Output::container_type::value_type; };
+
+}
+
 /**
- * \brief Packs bits into \ref PackWord "PackWords" and emits them to an output iterator.
+ * \brief Packs bits into pack words and emits them to an output iterator.
  * 
  * This class maintains a \em current pack word that bits are written to.
  * When the pack word is full, \ref flush is called or the packer is destroyed, the word is forwarded to the specified output iterator.
  * 
+ * The pack word type determines the output format.
+ * By default, it is \ref PackWord , unless the output iterator is a \ref CharUnpacker or an insert iterator into a container of another pack word type, in which case that type is used.
+ * 
  * This class satisfies the \ref iopp::BitSink concept.
  * 
- * \tparam Pack the pack integer type
  * \tparam Output the output iterator type
+ * \tparam Word the pack word type
  */
-template<std::output_iterator<PackWord> Output>
+template<typename Output, PackWordType Word = typename detail::default_pack_word<Output>::type>
+requires std::output_iterator<Output, Word>
 class BitPacker {
-private:
-    static constexpr size_t FINALIZER_BITS = std::bit_width(PACK_WORD_BITS - 1);
-    static constexpr size_t PAYLOAD_BITS = PACK_WORD_BITS - FINALIZER_BITS;
-    static constexpr size_t FINALIZER_LSH = PAYLOAD_BITS - 1;
+public:
+    /**
+     * \brief The pack word type
+     */
+    using word_type = Word;
 
-    static constexpr PackWord encode_finalizer(size_t const finalizer) {
-        return (PackWord(finalizer) - 1) << FINALIZER_LSH;
-    }
+private:
+    static constexpr size_t WORD_BITS = pack_word_bits<Word>;
+    static constexpr size_t PAYLOAD_BITS = detail::Finalizer<Word>::PAYLOAD_BITS;
 
-    PackWord pack_;
+    Word pack_;
     size_t i_;
     size_t num_bits_written_;
 
@@ -71,11 +96,25 @@ private:
     bool finalize_;
     bool was_ever_flushed_;
 
+    [[no_unique_address]] detail::IoProbe probe_;
+
     void reset() {
         pack_ = 0U;
         i_ = 0;
     }
 
+    template<size_t K, std::unsigned_integral T>
+    void write_many_fixed(T const* in, size_t const count) {
+        for(size_t i = 0; i < count; i++) {
+            this->template write<K>(in[i]);
+        }
+    }
+
+    template<std::unsigned_integral T, size_t... Ks>
+    static constexpr auto write_many_table(std::index_sequence<Ks...>) {
+        return std::array<void (BitPacker::*)(T const*, size_t), sizeof...(Ks)> { &BitPacker::write_many_fixed<Ks + 1, T>... };
+    }
+
 public:
     /**
      * \brief Constructs a bit packer
@@ -94,16 +133,17 @@ public:
     ~BitPacker() {
         bool const non_empty = (was_ever_flushed_ || i_ > 0); // nb: we don't write a finalizer if the output stream is empty
         if(finalize_ && non_empty) {
-            PackWord const finalizer = encode_finalizer(i_);
+            Word const finalizer = detail::Finalizer<Word>::encode(i_);
             if(i_ >= PAYLOAD_BITS) {
                 // finalization info no longer fits into this pack word, flush and write it to the next
                 flush();
             }
 
             pack_ |= finalizer;
-            i_ = PACK_WORD_BITS; // nb: make sure the final flush will do something even if this is a new (final) word
+            i_ = WORD_BITS; // nb: make sure the final flush will do something even if this is a new (final) word
         }
         flush();
+        probe_.publish_flushes();
     }
 
     /**
@@ -113,48 +153,115 @@ public:
      */
     void write(bool const bit) {
         // write single bit
-        pack_ |= set_bit(i_) & (-bit); // nb: branchless ternary version of (bit ? set_bit(i_) : 0)
+        pack_ |= Word(bit) << i_;
         ++num_bits_written_;
 
         // potentially flush
-        if(++i_ >= PACK_WORD_BITS) flush();
+        if(++i_ >= WORD_BITS) flush();
     }
 
     /**
      * \brief Writes multiple bits to the output
      * 
      * The bits are given as the low bits of an unsigned integer.
-     * Any bits beyond the `PACK_WORD_BITS` bits of the input integer will be clear.
+     * Any bits of the input integer beyond the width of the pack word type will be clear.
      * 
      * \param bits the unsigned integer containing the bits to be written
      * \param num the number of low bits from `bits` to be written
      */
-    void write(uintmax_t bits, size_t num) {
+    void write(Word bits, size_t num) {
         assert(num > 0);
         auto const in_num = num;
 
         // write num low bits (in MSBF order)
-        while(i_ + num > PACK_WORD_BITS) {
+        while(i_ + num > WORD_BITS) {
             // not all bits fit into current pack, write as many as possible and advance
-            auto const fit = PACK_WORD_BITS - i_;
-            pack_ |= extract_low(bits, fit) << i_;
+            auto const fit = WORD_BITS - i_;
+            pack_ |= extract_low<Word>(bits, fit) << i_;
 
-            i_ = PACK_WORD_BITS;
+            i_ = WORD_BITS;
             flush();
-            bits >>= fit; // nb: safe, because fit < 64
+            bits >>= fit; // nb: safe, because fit < WORD_BITS
             num -= fit;
         }
 
         // all remaining bits completely fit into the current pack
         if(num) {
-            pack_ |= extract_low(bits, num) << i_;
+            pack_ |= extract_low<Word>(bits, num) << i_;
             i_ += num;
-            if(i_ >= PACK_WORD_BITS) flush();
+            if(i_ >= WORD_BITS) flush();
         }
 
         num_bits_written_ += in_num;
     }
 
+    /**
+     * \brief Writes a number of bits known at compile time
+     * 
+     * This is equivalent to calling \ref write(Word, size_t) with `N`, but does not require a loop.
+     * 
+     * \tparam N the number of low bits from `bits` to be written, must be in `[1, w]`, where `w` is the width of the pack word type
+     * \param bits the unsigned integer containing the bits to be written
+     */
+    template<size_t N>
+    void write(Word bits) {
+        static_assert(N > 0 && N <= WORD_BITS);
+
+        bits = extract_low<Word>(bits, N);
+        pack_ |= bits << i_; // nb: i_ < WORD_BITS, bits that don't fit are written to the next pack below
+        if(i_ + N >= WORD_BITS) {
+            // the current pack is full, write the remaining bits to the next
+            size_t const fit = WORD_BITS - i_;
+            i_ = WORD_BITS;
+            flush();
+            if(fit < N) {
+                pack_ = bits >> fit;
+                i_ = N - fit;
+            }
+        } else {
+            i_ += N;
+        }
+        num_bits_written_ += N;
+    }
+
+    /**
+     * \brief Writes a number in unary code, i.e., the given number of 0-bits followed by a 1-bit
+     * 
+     * This is equivalent to calling \ref write(bool) for each bit, but the 0-bits are skipped over in a single step per pack word.
+     * 
+     * \param n the number to encode
+     */
+    void write_unary(uintmax_t n) {
+        num_bits_written_ += n + 1;
+        while(i_ + n >= WORD_BITS) {
+            // the terminating 1-bit does not fit into the current pack, skip its remaining bits
+            n -= WORD_BITS - i_;
+            i_ = WORD_BITS;
+            flush();
+        }
+
+        pack_ |= set_bit<Word>(i_ + n);
+        i_ += n + 1;
+        if(i_ >= WORD_BITS) flush();
+    }
+
+    /**
+     * \brief Writes multiple integers of the same bit width
+     * 
+     * This is equivalent to calling \ref write(Word, size_t) with `k` for each integer, but uses a kernel specialized for the given width.
+     * 
+     * \tparam T the input integer type
+     * \param k the number of low bits to write from each integer, must be in `[1, w]`, where `w` is the width of the pack word type
+     * \param in the input array
+     * \param count the number of integers to write
+     */
+    template<std::unsigned_integral T>
+    void write_many(size_t const k, T const* in, size_t const count) {
+        assert(k > 0 && k <= WORD_BITS);
+        static constexpr auto kernels = write_many_table<T>(std::make_index_sequence<WORD_BITS>());
+        (this->*kernels[k - 1])(in, count);
+    }
+
     /**
      * \brief Flushes the current bit pack to the output
      * 
@@ -163,6 +270,7 @@ public:
     void flush() {
         if(i_) {
             was_ever_flushed_ = true;
+            probe_.flush();
 
             *out_++ = pack_;
             reset();
@@ -178,7 +286,7 @@ public:
      * 
      * \return the position of the next bit to be written in the current pack word
      */
-    size_t pack_pos() const { return i_ % PACK_WORD_BITS; }
+    size_t pack_pos() const { return i_ % WORD_BITS; }
 
     /**
      * \brief Reports the number of bits written since instantiation.
@@ -188,6 +296,16 @@ public:
      * \return the number of bits written since instantiation
      */
     size_t num_bits_written() const { return num_bits_written_; }
+
+    /**
+     * \brief Reports the I/O statistics of this bit packer
+     * 
+     * The only statistic gathered is the number of flushed pack words, which is added to the \ref process_io_stats "process-wide statistics" upon destruction.
+     * Unless \ref INSTRUMENTATION_ENABLED "instrumentation is enabled", it is zero.
+     * 
+     * \return the I/O statistics
+     */
+    IoStats io_stats() const { return probe_.stats(); }
 };
 
 }
@@ -0,0 +1,283 @@
+/**
+ * util/bit_reader.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_UTIL_BIT_READER_HPP
+#define _IOPP_UTIL_BIT_READER_HPP
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <span>
+
+#include "bits.hpp"
+#include "pack_word.hpp"
+#include "../memory_mapped_file.hpp"
+
+namespace iopp {
+
+/**
+ * \brief Random access to bits packed into pack words in contiguous memory
+ * 
+ * In contrast to \ref BitUnpacker , which can only move forward, this class allows for reading bits at arbitrary positions.
+ * The bits are expected in the format written by \ref BitPacker ; they can be taken either from a span of pack words, or from serialized pack words as written by \ref CharUnpacker , e.g., a memory-mapped file written using \ref bitwise_output_to .
+ * In the latter case, nothing needs to be loaded into memory up front.
+ * 
+ * The reader maintains a current bit position for sequential reading, which can be moved using \ref seek_bit .
+ * In addition, \ref get_bits reads bits at any position without affecting the current position.
+ * For instance, the `i`-th integer of a vector packed using a fixed bit width `k` is retrieved in constant time via `get_bits(i * k, k)`.
+ * 
+ * This class satisfies the \ref iopp::FixedWidthBitSource "FixedWidthBitSource" concept.
+ * Use the \ref BitReader alias for the default \ref PackWord type.
+ * 
+ * \tparam Word the pack word type, which must match the one the bits were written with
+ */
+template<PackWordType Word>
+class BasicBitReader {
+private:
+    using Finalizer = detail::Finalizer<Word>;
+
+    static constexpr size_t WORD_BITS = Finalizer::WORD_BITS;
+    static constexpr size_t PAYLOAD_BITS = Finalizer::PAYLOAD_BITS;
+
+    Word const* words_;     // the pack words, if given as such
+    char const* chars_;     // the serialized pack words, otherwise
+    size_t num_words_;
+    size_t num_bits_;
+    size_t pos_;
+
+    inline Word word(size_t const i) const {
+        return words_ ? words_[i] : load_pack_word<Word>(chars_ + i * sizeof(Word));
+    }
+
+    // determines the number of payload bits from the finalizer
+    inline void init(bool const finalized) {
+        if(finalized && num_words_ > 0) {
+            auto const avail = Finalizer::decode(word(num_words_ - 1));
+            if(avail >= PAYLOAD_BITS && num_words_ > 1) {
+                // the finalizer was written to an extra word, so it refers to the previous word
+                num_bits_ = (num_words_ - 2) * WORD_BITS + avail;
+            } else {
+                num_bits_ = (num_words_ - 1) * WORD_BITS + avail;
+            }
+        } else {
+            num_bits_ = num_words_ * WORD_BITS;
+        }
+    }
+
+public:
+    /**
+     * \brief Constructs an empty bit reader
+     */
+    inline BasicBitReader() : words_(nullptr), chars_(nullptr), num_words_(0), num_bits_(0), pos_(0) {
+    }
+
+    /**
+     * \brief Constructs a bit reader over pack words in memory
+     * 
+     * \param words the pack words
+     * \param finalized whether the bits have been written by a \ref BitPacker with finalization; if not, all bits of all words are considered payload
+     */
+    inline BasicBitReader(std::span<Word const> words, bool const finalized = true) : words_(words.data()), chars_(nullptr), num_words_(words.size()), pos_(0) {
+        init(finalized);
+    }
+
+    /**
+     * \brief Constructs a bit reader over serialized pack words
+     * 
+     * Each pack word is expected to be stored as written by \ref CharUnpacker , i.e., starting with its most significant byte.
+     * Trailing characters that do not make up a whole pack word are ignored.
+     * 
+     * \param begin pointer to the first character
+     * \param end pointer to the character after the last character
+     * \param finalized whether the bits have been written by a \ref BitPacker with finalization; if not, all bits of all words are considered payload
+     */
+    inline BasicBitReader(char const* begin, char const* end, bool const finalized = true) : words_(nullptr), chars_(begin), num_words_((end - begin) / sizeof(Word)), pos_(0) {
+        init(finalized);
+    }
+
+    /**
+     * \brief Constructs a bit reader over a memory-mapped file containing serialized pack words
+     * 
+     * The mapping must outlive the bit reader.
+     * 
+     * \param mapping the memory mapping
+     * \param finalized whether the bits have been written by a \ref BitPacker with finalization; if not, all bits of all words are considered payload
+     */
+    inline BasicBitReader(MemoryMappedFile const& mapping, bool const finalized = true)
+        : BasicBitReader((char const*)mapping.data(), (char const*)mapping.data() + mapping.size(), finalized) {
+    }
+
+    /**
+     * \brief Reads bits at the given position without affecting the current position
+     * 
+     * The read bits will occupy the low bits of the returned word.
+     * 
+     * \param pos the position of the first bit to read
+     * \param num the number of bits to read, must be in `[1, WORD_BITS]`; the bits must not exceed the payload
+     * \return the read bits
+     */
+    inline Word get_bits(size_t const pos, size_t const num) const {
+        assert(num > 0 && num <= WORD_BITS);
+        assert(pos + num <= num_bits_);
+
+        size_t const i = pos / WORD_BITS;
+        size_t const j = pos % WORD_BITS;
+        Word bits = word(i) >> j;
+        if(j + num > WORD_BITS) {
+            // the bits continue in the next word
+            bits |= word(i + 1) << (WORD_BITS - j);
+        }
+        return extract_low<Word>(bits, num);
+    }
+
+    /**
+     * \brief Tests a single bit at the given position without affecting the current position
+     * 
+     * \param pos the position of the bit; must be less than \ref size
+     * \return the value of the bit
+     */
+    inline bool get_bit(size_t const pos) const {
+        assert(pos < num_bits_);
+        return (bool)(word(pos / WORD_BITS) & set_bit<Word>(pos % WORD_BITS));
+    }
+
+    /**
+     * \brief Reads a single bit at the current position and advances
+     * 
+     * \return the value of the read bit
+     */
+    inline bool read() {
+        return get_bit(pos_++);
+    }
+
+    /**
+     * \brief Reads multiple bits at the current position and advances
+     * 
+     * \param num the number of bits to read, must be in `[1, WORD_BITS]`
+     * \return the read bits
+     */
+    inline Word read(size_t const num) {
+        Word const bits = get_bits(pos_, num);
+        pos_ += num;
+        return bits;
+    }
+
+    /**
+     * \brief Reads a number of bits known at compile time at the current position and advances
+     * 
+     * \tparam N the number of bits to read, must be in `[1, WORD_BITS]`
+     * \return the read bits
+     */
+    template<size_t N>
+    inline Word read() {
+        static_assert(N > 0 && N <= WORD_BITS);
+        return read(N);
+    }
+
+    /**
+     * \brief Reads a number in unary code at the current position, i.e., counts the 0-bits up to the next 1-bit, and advances
+     * 
+     * The 1-bit is consumed as well.
+     * Instead of reading bit by bit, the 0-bits are counted in a single step per pack word using \ref countr_zero.
+     * 
+     * \return the number of 0-bits preceding the next 1-bit, or the number of remaining bits if there is no 1-bit
+     */
+    inline size_t read_unary() {
+        size_t const start = pos_;
+        while(pos_ < num_bits_) {
+            Word const rest = word(pos_ / WORD_BITS) >> (pos_ % WORD_BITS);
+            if(rest) [[likely]] {
+                size_t const p = pos_ + countr_zero(rest);
+                if(p >= num_bits_) break; // nb: this is a bit of the finalizer
+                pos_ = p + 1;
+                return p - start;
+            }
+            pos_ += WORD_BITS - pos_ % WORD_BITS;
+        }
+
+        // there is no 1-bit, the input is malformed
+        pos_ = num_bits_;
+        return pos_ - start;
+    }
+
+    /**
+     * \brief Moves the current position
+     * 
+     * \param pos the new current position; may be at most \ref size
+     */
+    inline void seek_bit(size_t const pos) {
+        assert(pos <= num_bits_);
+        pos_ = pos;
+    }
+
+    /**
+     * \brief Reports the current position
+     * 
+     * \return the position of the next bit to be read
+     */
+    inline size_t tell_bit() const { return pos_; }
+
+    /**
+     * \brief Reports the number of payload bits
+     * 
+     * \return the number of bits that can be read
+     */
+    inline size_t size() const { return num_bits_; }
+
+    /**
+     * \brief Tests whether more bits can be read from the current position
+     * 
+     * \return true if there is at least one more bit to read
+     * \return false if the end of the payload was reached
+     */
+    inline bool good() const { return pos_ < num_bits_; }
+
+    /**
+     * \brief Shorthand alternative to \ref good .
+     * 
+     * \return true if there is at least one more bit to read
+     * \return false if the end of the payload was reached
+     */
+    inline operator bool() const { return good(); }
+
+    /**
+     * \brief Tests whether the end of the payload has been reached
+     * 
+     * \return true if all bits have been read
+     * \return false if there are still bits to read
+     */
+    inline bool eof() const { return pos_ >= num_bits_; }
+};
+
+/**
+ * \brief \ref BasicBitReader for the default \ref PackWord type
+ */
+using BitReader = BasicBitReader<PackWord>;
+
+}
+
+#endif
@@ -28,10 +28,15 @@
 #ifndef _IOPP_UTIL_BIT_UNPACKER_HPP
 #define _IOPP_UTIL_BIT_UNPACKER_HPP
 
+#include <algorithm>
+#include <array>
 #include <bit>
 #include <cassert>
+#include <concepts>
 #include <cstddef>
 #include <iterator>
+#include <type_traits>
+#include <utility>
 
 #include "../concepts.hpp"
 #include "bits.hpp"
@@ -39,29 +44,43 @@
 
 namespace iopp {
 
+namespace detail {
+
+// determines the pack word type for an input iterator, which is its value type if that is a pack word type, or otherwise PackWord
+template<typename Input>
+using input_pack_word_t = std::conditional_t<PackWordType<std::iter_value_t<Input>>, std::iter_value_t<Input>, PackWord>;
+
+}
+
 /**
- * \brief Unpacks bits from \ref PackWord "PackWords" taken from an input iterator.
+ * \brief Unpacks bits from pack words taken from an input iterator.
  * 
  * This class maintains a \em current pack word that bits are read from.
- * The pack word type is determined by the input iterator.
+ * The pack word type is determined by the input iterator: it is the iterator's value type if that satisfies \ref iopp::PackWordType "PackWordType", or \ref PackWord otherwise.
  * When the pack word runs empty, the next pack word is read using the input iterator.
  * 
  * \tparam Input the input iterator type
  */
-template<InputIterator<PackWord> Input>
+template<std::input_iterator Input>
+requires std::convertible_to<std::iter_value_t<Input>, detail::input_pack_word_t<Input>>
 class BitUnpacker {
+public:
+    /**
+     * \brief The pack word type
+     */
+    using word_type = detail::input_pack_word_t<Input>;
+
 private:
-    static constexpr size_t decode_finalizer(PackWord const x) {
-        size_t const f = ((x >> FINALIZER_LSH) + 1) % PACK_WORD_BITS;
-        return f ? f : PACK_WORD_BITS; // if finalizer is zero, it means we completely filled up the previous word
-    }
+    using Word = word_type;
+    static constexpr size_t WORD_BITS = pack_word_bits<Word>;
+    static constexpr size_t PAYLOAD_BITS = detail::Finalizer<Word>::PAYLOAD_BITS;
 
-    static constexpr size_t FINALIZER_BITS = std::bit_width(PACK_WORD_BITS - 1);
-    static constexpr size_t PAYLOAD_BITS = PACK_WORD_BITS - FINALIZER_BITS;
-    static constexpr size_t FINALIZER_LSH = PAYLOAD_BITS - 1;
+    static constexpr size_t decode_finalizer(Word const x) {
+        return detail::Finalizer<Word>::decode(x);
+    }
 
-    PackWord pack_;
-    PackWord next_;
+    Word pack_;
+    Word next_;
     size_t i_;
 
     Input in_;
@@ -99,6 +118,42 @@ private:
         }
     }
 
+    template<size_t K, std::unsigned_integral T>
+    void read_many_fixed(T* out, size_t const count) {
+        static constexpr Word MASK = low_mask<Word>(K);
+
+        // nb: the state is kept in locals, because writing to out could otherwise alias the members
+        Word pack = pack_;
+        Word next = next_;
+        size_t pos = i_;
+        for(size_t i = 0; i < count; i++) {
+            if(pos >= WORD_BITS) {
+                advance();
+                pack = pack_;
+                next = next_;
+                pos -= WORD_BITS;
+            }
+
+            // extract the integer from the current and the next pack word without branching on whether it straddles both
+            // nb: the next pack word is shifted in two steps to avoid shifting by the full word width
+            Word const bits = Word(pack >> pos) | Word(Word(next << 1) << (WORD_BITS - 1 - pos));
+            out[i] = (T)(bits & MASK);
+            pos += K;
+        }
+
+        if(pos > WORD_BITS) {
+            // the last integer straddled into the next pack word
+            advance();
+            pos -= WORD_BITS;
+        }
+        i_ = pos;
+    }
+
+    template<std::unsigned_integral T, size_t... Ks>
+    static constexpr auto read_many_table(std::index_sequence<Ks...>) {
+        return std::array<void (BitUnpacker::*)(T*, size_t), sizeof...(Ks)> { &BitUnpacker::read_many_fixed<Ks + 1, T>... };
+    }
+
 public:
     /**
      * \brief Constructs a bit unpacker
@@ -114,7 +169,7 @@ public:
      * \param in the input iterator for packed words
      * \param end the end iterator; required to detect the end of the bit stream
      */
-    BitUnpacker(Input in, Input end) : i_(PACK_WORD_BITS), in_(in), end_(end) {
+    BitUnpacker(Input in, Input end) : i_(WORD_BITS), in_(in), end_(end) {
         if(in_ == end_) {
             // the input is empty
             final_ = true;
@@ -132,31 +187,31 @@ public:
      * \return the value of the read bit
      */
     bool read() {
-        if(i_ >= PACK_WORD_BITS) advance();
-        return (bool)(pack_ & set_bit(i_++));
+        if(i_ >= WORD_BITS) advance();
+        return (bool)(pack_ & set_bit<Word>(i_++));
     }
 
     /**
      * \brief Reads multiple bits
      * 
      * The read bits will occupy the low bits of the returned word.
-     * In case more than `PACK_WORD_BITS` bits are read, the overflow bits are lost.
+     * In case more bits than the width of the pack word type are read, the overflow bits are lost.
      * 
      * \param num the number of bits to be read
      * \return the read bits
      */
-    PackWord read(size_t num) {
+    Word read(size_t num) {
         assert(num > 0);
 
-        PackWord bits = 0;
+        Word bits = 0;
         size_t j = 0;
 
-        if(i_ >= PACK_WORD_BITS) advance();
+        if(i_ >= WORD_BITS) advance();
 
-        while(i_ + num > PACK_WORD_BITS) {
+        while(i_ + num > WORD_BITS) {
             // not all bits can be read from current pack, read as many as possible and advance
-            auto const avail = PACK_WORD_BITS - i_;
-            bits |= extract_low(pack_ >> i_, avail) << j;
+            auto const avail = WORD_BITS - i_;
+            bits |= extract_low<Word>(pack_ >> i_, avail) << j;
 
             num -= avail;
             j += avail;
@@ -165,13 +220,86 @@ public:
 
         // all remaining bits can be read from the current pack
         if(num) {
-            bits |= extract_low(pack_ >> i_, num) << j;
+            bits |= extract_low<Word>(pack_ >> i_, num) << j;
             i_ += num;
         }
 
         return bits;
     }
 
+    /**
+     * \brief Reads a number of bits known at compile time
+     * 
+     * This is equivalent to calling \ref read(size_t) with `N`, but does not require a loop.
+     * 
+     * \tparam N the number of bits to read, must be in `[1, w]`, where `w` is the width of the pack word type
+     * \return the read bits
+     */
+    template<size_t N>
+    Word read() {
+        static_assert(N > 0 && N <= WORD_BITS);
+
+        if(i_ >= WORD_BITS) advance();
+        if(i_ + N <= WORD_BITS) [[likely]] {
+            Word const bits = extract_low<Word>(pack_ >> i_, N);
+            i_ += N;
+            return bits;
+        } else {
+            // read the remaining bits from the current pack and the rest from the next
+            size_t const avail = WORD_BITS - i_;
+            Word bits = pack_ >> i_;
+            advance();
+            bits |= extract_low<Word>(pack_, N - avail) << avail;
+            i_ = N - avail;
+            return bits;
+        }
+    }
+
+    /**
+     * \brief Reads a number in unary code, i.e., counts the 0-bits up to the next 1-bit
+     * 
+     * The 1-bit is consumed as well.
+     * Instead of reading bit by bit, the 0-bits are counted in a single step per pack word using `std::countr_zero`.
+     * 
+     * \return the number of 0-bits preceding the next 1-bit, or the number of remaining bits if there is no 1-bit
+     */
+    size_t read_unary() {
+        if(i_ >= WORD_BITS) advance();
+
+        size_t n = 0;
+        while(true) {
+            Word const rest = pack_ >> i_;
+            if(rest) [[likely]] {
+                size_t const z = countr_zero(rest);
+                i_ += z + 1;
+                return n + z;
+            }
+
+            // all remaining bits of the current pack are zero
+            n += WORD_BITS - i_;
+            i_ = WORD_BITS;
+            if(final_) return n; // nb: there is no 1-bit, the input is malformed
+            advance();
+        }
+    }
+
+    /**
+     * \brief Reads multiple integers of the same bit width
+     * 
+     * This is equivalent to calling \ref read(size_t) with `k` for each integer, but uses a kernel specialized for the given width that decodes each integer from the current and the next pack word without branching on whether it straddles both.
+     * 
+     * \tparam T the output integer type; if the bit width exceeds the type's width, the high bits are lost
+     * \param k the bit width of each integer, must be in `[1, w]`, where `w` is the width of the pack word type
+     * \param out the output array
+     * \param count the number of integers to read
+     */
+    template<std::unsigned_integral T>
+    void read_many(size_t const k, T* out, size_t const count) {
+        assert(k > 0 && k <= WORD_BITS);
+        static constexpr auto kernels = read_many_table<T>(std::make_index_sequence<WORD_BITS>());
+        (this->*kernels[k - 1])(out, count);
+    }
+
     /**
      * \brief Returns the position of the next bit to be read in the current pack word
      * 
@@ -181,7 +309,7 @@ public:
      * 
      * \return size_t the position of the next bit to be read in the current pack word
      */
-    size_t pack_pos() const { return i_ % PACK_WORD_BITS; }
+    size_t pack_pos() const { return i_ % WORD_BITS; }
 
     /**
      * \brief Tests whether more bits can be read from the stream
@@ -28,41 +28,119 @@
 #ifndef _IOPP_UTIL_BITS_HPP
 #define _IOPP_UTIL_BITS_HPP
 
+#include <bit>
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
 namespace iopp {
 
+/**
+ * \brief Concept for unsigned integer types, including the 128-bit integer extension if the compiler provides it
+ * 
+ * \tparam T the type
+ */
+template<typename T>
+concept UnsignedInteger =
+    std::unsigned_integral<T>
+#ifdef __SIZEOF_INT128__
+    || std::same_as<T, unsigned __int128>
+#endif
+    ;
+
 /**
  * \brief Constructs an unsigned integer where the `i`-th bit is set and all other bits are clear
  * 
- * \param i the index of the set bit; for values of 64 or above, the result is undefined
+ * \tparam Word the unsigned integer type
+ * \param i the index of the set bit; for values equal to or above the width of `Word`, the result is undefined
  * \return an unsigned integer where the `i`-th bit is set and all other bits are clear
  */
-constexpr inline uintmax_t set_bit(size_t const i) {
-    return uintmax_t(1) << i;
+template<UnsignedInteger Word = uintmax_t>
+constexpr inline Word set_bit(size_t const i) {
+    return Word(1) << i;
 }
 
 /**
  * \brief Computes a bit mask for the extraction of the given number of low bits
  * 
- * \param num the number of low bits to extract; for values outside of the interval `(0, 64]`, the result is undefined
+ * \tparam Word the unsigned integer type
+ * \param num the number of low bits to extract; for values outside of the interval `(0, w]`, where `w` is the width of `Word`, the result is undefined
  * \return an unsigned integer with the \c num lowest bits set to one and the high bits set to zero
  */
-constexpr inline uintmax_t low_mask(size_t const num) {
-    return ~((UINTMAX_MAX << (num - 1)) << 1);
+template<UnsignedInteger Word = uintmax_t>
+constexpr inline Word low_mask(size_t const num) {
+    return ~((Word(~Word(0)) << (num - 1)) << 1);
 }
 
 /**
  * \brief Extracts low bits from the given integer
  * 
+ * \tparam Word the unsigned integer type
  * \param v the integer to extract bits from
- * \param num the number of low bits to extract; for values outside of the interval `(0, 64]`, the result is undefined
+ * \param num the number of low bits to extract; for values outside of the interval `(0, w]`, where `w` is the width of `Word`, the result is undefined
  * \return an unsigned integer containing the `num` low bits of `v` with the remaining high bits set to zero
  */
-constexpr inline uintmax_t extract_low(uintmax_t const v, size_t const num) {
-    // nb: we expect num to be in (0, 64]
-    return v & low_mask(num);
+template<UnsignedInteger Word = uintmax_t>
+constexpr inline Word extract_low(std::type_identity_t<Word> const v, size_t const num) {
+    // nb: we expect num to be in (0, w]
+    return v & low_mask<Word>(num);
+}
+
+/**
+ * \brief Counts the consecutive 0-bits starting from the least significant bit
+ * 
+ * This is equivalent to `std::countr_zero`, but also supports the 128-bit integer extension.
+ * 
+ * \tparam T the unsigned integer type
+ * \param x the integer
+ * \return the number of consecutive 0-bits starting from the least significant bit
+ */
+template<UnsignedInteger T>
+constexpr inline int countr_zero(T const x) {
+    if constexpr(sizeof(T) > sizeof(uint64_t)) {
+        uint64_t const lo = (uint64_t)x;
+        return lo ? std::countr_zero(lo) : 64 + std::countr_zero((uint64_t)(x >> 64));
+    } else {
+        return std::countr_zero(x);
+    }
+}
+
+/**
+ * \brief Reverses the bytes of the given unsigned integer
+ * 
+ * This is equivalent to C++23's `std::byteswap`, which is used if available, but also supports the 128-bit integer extension.
+ * 
+ * \tparam T the unsigned integer type
+ * \param x the integer
+ * \return the integer with the order of its bytes reversed
+ */
+template<UnsignedInteger T>
+constexpr inline T byteswap(T const x) {
+    if constexpr(sizeof(T) > sizeof(uint64_t)) {
+        // swap the halves and the bytes within them
+        return (T(byteswap((uint64_t)x)) << 64) | T(byteswap((uint64_t)(x >> 64)));
+    } else {
+        #ifdef __cpp_lib_byteswap
+        return std::byteswap(x);
+        #else
+        if constexpr(sizeof(T) == 1) {
+            return x;
+        } else if constexpr(sizeof(T) == 2) {
+            return __builtin_bswap16(x);
+        } else if constexpr(sizeof(T) == 4) {
+            return __builtin_bswap32(x);
+        } else if constexpr(sizeof(T) == 8) {
+            return __builtin_bswap64(x);
+        } else {
+            T y = 0;
+            for(size_t i = 0; i < sizeof(T); i++) {
+                y = (y << 8) | ((x >> (8 * i)) & 0xFF);
+            }
+            return y;
+        }
+        #endif
+    }
 }
 
 }
@@ -0,0 +1,257 @@
+/**
+ * util/buffer_pool.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_UTIL_BUFFER_POOL_HPP
+#define _IOPP_UTIL_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "aligned_buffer.hpp"
+#include "../memory_mapped_file.hpp"
+
+namespace iopp {
+
+/**
+ * \brief A pool of aligned, uninitialized buffers that can be borrowed and given back
+ * 
+ * Buffers are acquired via \ref acquire and automatically given back to the pool when the returned \ref AlignedBuffer is destroyed.
+ * Given back buffers are kept in free lists for reuse by later acquisitions of the same size, avoiding the allocation cost.
+ * 
+ * In order to avoid contention, the pool maintains multiple free lists, each guarded by its own mutex, and each thread primarily uses the one determined by its ID.
+ * Only if that list contains no fitting buffer, the other lists are searched, skipping those that are currently locked.
+ * 
+ * Optionally, buffers at least as large as a huge page are aligned to huge pages and advised to be backed by them.
+ * 
+ * The pool must outlive all buffers acquired from it.
+ */
+class BufferPool {
+private:
+    static constexpr size_t NUM_SHARDS = 16;
+
+    struct Entry {
+        unsigned char* p;
+        size_t size;
+        std::align_val_t align;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> free;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t max_cached_per_shard_;
+    bool huge_pages_;
+
+    static void release_func(void* ctx, unsigned char* p, size_t const size, std::align_val_t const align) {
+        ((BufferPool*)ctx)->release(p, size, align);
+    }
+
+    Shard& home_shard() const {
+        return shards_[std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_SHARDS];
+    }
+
+    static bool take(std::vector<Entry>& free, size_t const size, std::align_val_t const align, Entry& out) {
+        for(size_t i = free.size(); i > 0; i--) {
+            auto const& e = free[i - 1];
+            if(e.size == size && e.align >= align) {
+                out = e;
+                free.erase(free.begin() + (i - 1));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(unsigned char* p, size_t const size, std::align_val_t const align) {
+        {
+            auto& shard = home_shard();
+            std::lock_guard lock(shard.mutex);
+            if(shard.free.size() < max_cached_per_shard_) {
+                shard.free.push_back({ p, size, align });
+                return;
+            }
+        }
+
+        // the free list is full
+        ::operator delete[](p, align);
+    }
+
+    AlignedBuffer wrap(Entry const& e) {
+        return AlignedBuffer(e.p, AlignedBufferDeleter { e.align, e.size, release_func, this });
+    }
+
+public:
+    /**
+     * \brief Constructs an empty buffer pool
+     * 
+     * \param max_cached_per_shard the maximum number of buffers kept in each of the pool's free lists; further given back buffers are deleted
+     * \param huge_pages whether buffers at least as large as a huge page should be backed by huge pages
+     */
+    inline BufferPool(size_t const max_cached_per_shard = 16, bool const huge_pages = false)
+        : shards_(std::make_unique<Shard[]>(NUM_SHARDS)), max_cached_per_shard_(max_cached_per_shard), huge_pages_(huge_pages) {
+    }
+
+    inline ~BufferPool() {
+        clear();
+    }
+
+    BufferPool(BufferPool const&) = delete;
+    BufferPool& operator=(BufferPool const&) = delete;
+
+    /**
+     * \brief Borrows an uninitialized buffer from the pool
+     * 
+     * If no fitting buffer is available for reuse, a new one is allocated.
+     * The buffer is given back to the pool when the returned object is destroyed.
+     * 
+     * \param size the size of the buffer
+     * \param align the alignment, which must be a power of two
+     * \return the borrowed buffer
+     */
+    inline AlignedBuffer acquire(size_t const size, size_t align = alignof(std::max_align_t)) {
+        align = std::max(align, alignof(std::max_align_t));
+
+        bool const huge = huge_pages_ && size >= MemoryMappedFile::huge_page_size();
+        if(huge) align = std::max(align, MemoryMappedFile::huge_page_size());
+
+        auto const a = std::align_val_t(align);
+        Entry e;
+
+        // try the thread's own free list first
+        auto& home = home_shard();
+        {
+            std::lock_guard lock(home.mutex);
+            if(take(home.free, size, a, e)) return wrap(e);
+        }
+
+        // try stealing from other free lists that are not currently in use
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            auto& shard = shards_[i];
+            if(&shard == &home) continue;
+
+            std::unique_lock lock(shard.mutex, std::try_to_lock);
+            if(lock.owns_lock() && take(shard.free, size, a, e)) return wrap(e);
+        }
+
+        // allocate a new buffer
+        e = { (unsigned char*)::operator new[](size, a), size, a };
+
+        #if defined(IOPP_POSIX_MMAP) && defined(MADV_HUGEPAGE)
+        if(huge) madvise(e.p, size, MADV_HUGEPAGE);
+        #endif
+
+        return wrap(e);
+    }
+
+    /**
+     * \brief Deletes all buffers currently held for reuse
+     */
+    inline void clear() {
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            auto& shard = shards_[i];
+            std::lock_guard lock(shard.mutex);
+            for(auto const& e : shard.free) ::operator delete[](e.p, e.align);
+            shard.free.clear();
+        }
+    }
+
+    /**
+     * \brief Reports the number of buffers currently held for reuse
+     * 
+     * \return the number of buffers in the pool's free lists
+     */
+    inline size_t num_cached() const {
+        size_t num = 0;
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            auto& shard = shards_[i];
+            std::lock_guard lock(shard.mutex);
+            num += shard.free.size();
+        }
+        return num;
+    }
+};
+
+namespace detail {
+
+inline std::atomic<BufferPool*>& stream_buffer_pool() {
+    static std::atomic<BufferPool*> pool = nullptr;
+    return pool;
+}
+
+}
+
+/**
+ * \brief Sets the buffer pool that file streams borrow their buffers from
+ * 
+ * Streams constructed after this call borrow their buffers from the given pool, which must outlive them.
+ * Passing \c nullptr makes streams allocate their own buffers again, which is the default.
+ * 
+ * \param pool the buffer pool, or \c nullptr
+ */
+inline void set_stream_buffer_pool(BufferPool* pool) {
+    detail::stream_buffer_pool().store(pool, std::memory_order_release);
+}
+
+/**
+ * \brief Reports the buffer pool that file streams borrow their buffers from
+ * 
+ * \return the buffer pool set using \ref set_stream_buffer_pool , or \c nullptr if none is set
+ */
+inline BufferPool* stream_buffer_pool() {
+    return detail::stream_buffer_pool().load(std::memory_order_acquire);
+}
+
+/**
+ * \brief Allocates an uninitialized stream buffer
+ * 
+ * If a \ref set_stream_buffer_pool "stream buffer pool" is set, the buffer is borrowed from it.
+ * Otherwise, it is allocated using \ref make_aligned_buffer .
+ * 
+ * \param size the size of the buffer
+ * \param align the alignment, which must be a power of two
+ * \return the allocated buffer
+ */
+inline AlignedBuffer make_stream_buffer(size_t const size, size_t const align = alignof(std::max_align_t)) {
+    if(auto* pool = stream_buffer_pool()) {
+        return pool->acquire(size, align);
+    } else {
+        return make_aligned_buffer(size, align);
+    }
+}
+
+}
+
+#endif
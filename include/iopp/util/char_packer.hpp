@@ -29,6 +29,9 @@
 #define _IOPP_UTIL_CHAR_PACKER_HPP
 
 #include <bit>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
 
 #include "dead_end.hpp"
 #include "pack_word.hpp"
@@ -51,23 +54,52 @@ namespace iopp {
  * std::copy(CharPacker(s.begin(), s.end()), {}, std::back_inserter(v));
  * \endcode
  * 
+ * If the source iterator is contiguous, e.g., a pointer, each word is loaded from memory at once.
+ * If the source iterator provides a `read` function like \ref StreamInputIterator , the characters for each word are read at once.
+ * Otherwise, characters are read one by one.
+ * 
  * This class satisfies the `std::input_iterator` concept.
  * 
  * \tparam CharInputIterator the source iterator type
+ * \tparam Word the pack word type
  */
-template<InputIterator<char> CharInputIterator>
+template<InputIterator<char> CharInputIterator, PackWordType Word = PackWord>
 class CharPacker {
 private:
     CharInputIterator in_, end_;
 
-    PackWord current_;
+    Word current_;
     bool reached_end_;
 
     void advance() {
         reached_end_ = (in_ == end_);
         if(!reached_end_) {
-            constexpr size_t chars_per_int = sizeof(PackWord);
-            if constexpr(std::endian::native == std::endian::little) {
+            constexpr size_t chars_per_int = sizeof(Word);
+            if constexpr(ContiguousCharIterator<CharInputIterator>) {
+                // load the word directly from memory
+                size_t avail = SIZE_MAX;
+                if constexpr(std::is_pointer_v<CharInputIterator>) {
+                    if(end_) avail = end_ - in_; // nb: a null end pointer means there is no end
+                } else {
+                    avail = end_ - in_;
+                }
+
+                if(avail >= chars_per_int) [[likely]] {
+                    current_ = load_pack_word<Word>(std::to_address(in_));
+                    in_ += chars_per_int;
+                } else {
+                    // pad the final word with zeroes
+                    char buf[chars_per_int] = {};
+                    std::memcpy(buf, std::to_address(in_), avail);
+                    current_ = load_pack_word<Word>(buf);
+                    in_ = end_;
+                }
+            } else if constexpr(requires(CharInputIterator it, char* outp, size_t num) { { it.read(outp, num) } -> std::convertible_to<size_t>; }) {
+                // read the word's characters at once, the final word is padded with zeroes
+                char buf[chars_per_int] = {};
+                in_.read(buf, chars_per_int);
+                current_ = load_pack_word<Word>(buf);
+            } else if constexpr(std::endian::native == std::endian::little) {
                 char* p = (char*)&current_ + chars_per_int - 1;
                 for(size_t i = 0; i < chars_per_int; i++) {
                     *p-- = *in_++;
@@ -84,9 +116,9 @@ private:
 public:
     using iterator_category = std::input_iterator_tag;
     using difference_type   = std::ptrdiff_t;
-    using value_type        = PackWord;
-    using pointer           = PackWord*;
-    using reference         = PackWord&;
+    using value_type        = Word;
+    using pointer           = Word*;
+    using reference         = Word&;
 
     /**
      * \brief Constructs a character packer and immediately reads the initial word from it
@@ -102,7 +134,7 @@ public:
      * \brief Constructs an invalid character packer, which can serve as an \em end iterator
      * 
      */
-    CharPacker() : in_({}), end_({}), reached_end_(true) {}
+    CharPacker() : in_(), end_(), reached_end_(true) {}
     
     CharPacker(CharPacker const&) = default;
     CharPacker(CharPacker&&) = default;
@@ -136,7 +168,7 @@ public:
      * 
      * \return a const reference to the current pack word
      */
-    PackWord const& operator*() const { return current_; }
+    Word const& operator*() const { return current_; }
 
     /**
      * \brief Advances the iterator
@@ -28,10 +28,14 @@
 #ifndef _IOPP_UTIL_CHAR_UNPACKER_HPP
 #define _IOPP_UTIL_CHAR_UNPACKER_HPP
 
+#include <algorithm>
 #include <bit>
+#include <cstddef>
+#include <iterator>
 
 #include "output_iterator_base.hpp"
 #include "pack_word.hpp"
+#include "write_range.hpp"
 
 namespace iopp {
 
@@ -41,14 +45,24 @@ namespace iopp {
  * Words written via this iterator are unpacked into characters, which are then forwarded to the target iterator.
  * The number of characters that are extracted from one integer is determined by the \ref PackWord "pack word type".
  * 
- * This class satisfies the `std::output_iterator` concept for \ref PackWord .
+ * If the target iterator is contiguous, e.g., a pointer, each word is stored to memory at once.
+ * If the target iterator provides a `write` function like \ref StreamOutputIterator , the characters of each word are written at once.
+ * Otherwise, characters are written one by one.
+ * 
+ * Multiple words can be written at once using \ref write , e.g., via \ref write_range .
+ * 
+ * This class satisfies the `std::output_iterator` concept for the pack word type.
  * 
  * \tparam CharOutputIterator the target iterator
+ * \tparam Word the pack word type
  */
-template<std::output_iterator<char> CharOutputIterator>
-class CharUnpacker : public OutputIteratorBase<PackWord> {
+template<std::output_iterator<char> CharOutputIterator, PackWordType Word = PackWord>
+class CharUnpacker : public OutputIteratorBase<Word> {
 private:
-    using IteratorBase = OutputIteratorBase<PackWord>;
+    using IteratorBase = OutputIteratorBase<Word>;
+
+    // the maximum number of characters written at once by write
+    static constexpr size_t BATCH_CHARS = 1024;
 
     CharOutputIterator out_;
 
@@ -60,6 +74,9 @@ public:
     using IteratorBase::pointer;
     using IteratorBase::reference;
 
+    /// \brief The pack word type
+    using word_type = Word;
+
     /**
      * \brief Constructs a character unpacker
      * 
@@ -80,13 +97,22 @@ public:
  
     using IteratorBase::operator*;
  
-    auto operator++(int) { return LatentWriter<PackWord, std::remove_pointer_t<decltype(this)>>(*this); }
+    auto operator++(int) { return LatentWriter<Word, std::remove_pointer_t<decltype(this)>>(*this); }
  
     CharUnpacker& operator++() {
         auto& item = **this;
         
-        constexpr size_t chars_per_int = sizeof(PackWord);
-        if constexpr(std::endian::native == std::endian::little) {
+        constexpr size_t chars_per_int = sizeof(Word);
+        if constexpr(ContiguousCharIterator<CharOutputIterator>) {
+            // store the word directly to memory
+            store_pack_word<Word>(std::to_address(out_), item);
+            out_ += chars_per_int;
+        } else if constexpr(requires(CharOutputIterator it, char const* inp, size_t num) { it.write(inp, num); }) {
+            // write the word's characters at once
+            char buf[chars_per_int];
+            store_pack_word<Word>(buf, item);
+            out_.write(buf, chars_per_int);
+        } else if constexpr(std::endian::native == std::endian::little) {
             char* p = (char*)&item + chars_per_int - 1;
             for(size_t i = 0; i < chars_per_int; i++) {
                 *out_++ = *p--;
@@ -100,6 +126,40 @@ public:
 
         return *this;
     }
+
+    /**
+     * \brief Writes multiple pack words at once
+     * 
+     * This is equivalent to writing the words one by one, but if the target iterator provides a `write` function like \ref StreamOutputIterator , the characters of many words are written at once.
+     * 
+     * \param words the pack words to write
+     * \param num the number of pack words to write
+     */
+    void write(Word const* words, size_t const num) {
+        constexpr size_t chars_per_int = sizeof(Word);
+        if constexpr(ContiguousCharIterator<CharOutputIterator>) {
+            for(size_t i = 0; i < num; i++) {
+                store_pack_word<Word>(std::to_address(out_), words[i]);
+                out_ += chars_per_int;
+            }
+        } else if constexpr(requires(CharOutputIterator it, char const* inp, size_t num) { it.write(inp, num); }) {
+            // unpack the words into a buffer and write it at once
+            constexpr size_t words_per_batch = BATCH_CHARS / chars_per_int;
+            char buf[words_per_batch * chars_per_int];
+            for(size_t i = 0; i < num; i += words_per_batch) {
+                size_t const n = std::min(num - i, words_per_batch);
+                for(size_t j = 0; j < n; j++) {
+                    store_pack_word<Word>(buf + j * chars_per_int, words[i + j]);
+                }
+                out_.write(buf, n * chars_per_int);
+            }
+        } else {
+            for(size_t i = 0; i < num; i++) {
+                **this = words[i];
+                ++(*this);
+            }
+        }
+    }
 };
 
 }
@@ -0,0 +1,93 @@
+/**
+ * util/default_init_allocator.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_UTIL_DEFAULT_INIT_ALLOCATOR_HPP
+#define _IOPP_UTIL_DEFAULT_INIT_ALLOCATOR_HPP
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace iopp {
+
+/**
+ * \brief Allocator adaptor that default-initializes instead of value-initializing
+ * 
+ * When used with `std::vector`, `resize` does not zero-fill trivial types like integers.
+ * This saves touching the memory twice when it is going to be overwritten anyway, e.g., by \ref load_file .
+ * 
+ * \tparam T the value type
+ * \tparam A the underlying allocator type
+ */
+template<typename T, typename A = std::allocator<T>>
+class DefaultInitAllocator : public A {
+private:
+    using Traits = std::allocator_traits<A>;
+
+public:
+    template<typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U, typename Traits::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+
+    /**
+     * \brief Default-initializes an object if no constructor arguments are given
+     * 
+     * \param p the object's address
+     */
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new((void*)p) U;
+    }
+
+    /**
+     * \brief Constructs an object using the underlying allocator
+     * 
+     * \param p the object's address
+     * \param args the constructor arguments
+     */
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        Traits::construct(static_cast<A&>(*this), p, std::forward<Args>(args)...);
+    }
+};
+
+/**
+ * \brief A `std::vector` that does not value-initialize its items on `resize`
+ * 
+ * \tparam T the value type
+ */
+template<typename T>
+using UninitVector = std::vector<T, DefaultInitAllocator<T>>;
+
+}
+
+#endif
@@ -28,24 +28,107 @@
 #ifndef _IOPP_UTIL_PACK_WORD_HPP
 #define _IOPP_UTIL_PACK_WORD_HPP
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 
+#include "bits.hpp"
+
 namespace iopp {
+    /**
+     * \brief Concept for types that can serve as pack words for bitwise I/O
+     * 
+     * Pack words are unsigned integers of at least 32 bits, including the 128-bit integer extension if the compiler provides it.
+     * 
+     * \tparam T the type
+     */
+    template<typename T>
+    concept PackWordType = UnsignedInteger<T> && (sizeof(T) >= 4);
+
+    /**
+     * \brief The default pack word type
+     * 
+     * This determines the default format of bitwise I/O.
+     */
     using PackWord = uintmax_t;
 
+    /**
+     * \brief The number of bits that can be packed into a pack word of the given type
+     * 
+     * \tparam Word the pack word type
+     */
+    template<PackWordType Word>
+    constexpr size_t pack_word_bits = sizeof(Word) * 8;
+
     /**
      * \brief The number of bits that can be packed into a \ref PackWord .
      * 
      */
-    constexpr size_t PACK_WORD_BITS = std::numeric_limits<PackWord>::digits;
+    constexpr size_t PACK_WORD_BITS = pack_word_bits<PackWord>;
 
     /**
      * \brief The maximum value that can be assumed by a \ref PackWord .
      * 
      */
     constexpr PackWord PACK_WORD_MAX = std::numeric_limits<PackWord>::max();
+
+    /**
+     * \brief Loads a pack word from the given characters
+     * 
+     * The first character becomes the most significant byte of the word, matching the order used by \ref CharPacker .
+     * The characters need not be aligned.
+     * 
+     * \tparam Word the pack word type
+     * \param p pointer to the characters, of which `sizeof(Word)` are read
+     * \return the loaded pack word
+     */
+    template<PackWordType Word = PackWord>
+    inline Word load_pack_word(char const* p) {
+        Word x;
+        std::memcpy(&x, p, sizeof(Word));
+        if constexpr(std::endian::native == std::endian::little) x = byteswap(x);
+        return x;
+    }
+
+    /**
+     * \brief Stores a pack word to the given characters
+     * 
+     * The most significant byte of the word becomes the first character, matching the order used by \ref CharUnpacker .
+     * The characters need not be aligned.
+     * 
+     * \tparam Word the pack word type
+     * \param p pointer to the characters, of which `sizeof(Word)` are written
+     * \param x the pack word to store
+     */
+    template<PackWordType Word>
+    inline void store_pack_word(char* p, Word x) {
+        if constexpr(std::endian::native == std::endian::little) x = byteswap(x);
+        std::memcpy(p, &x, sizeof(Word));
+    }
+
+    namespace detail {
+
+    // the finalizer format for pack words of the given type, shared by BitPacker, BitUnpacker and BitReader
+    template<PackWordType Word>
+    struct Finalizer {
+        static constexpr size_t WORD_BITS = pack_word_bits<Word>;
+        static constexpr size_t BITS = std::bit_width(WORD_BITS - 1);
+        static constexpr size_t PAYLOAD_BITS = WORD_BITS - BITS;
+        static constexpr size_t LSH = PAYLOAD_BITS - 1;
+
+        static constexpr Word encode(size_t const finalizer) {
+            return (Word(finalizer) - 1) << LSH;
+        }
+
+        static constexpr size_t decode(Word const x) {
+            size_t const f = size_t((x >> LSH) + 1) % WORD_BITS;
+            return f ? f : WORD_BITS; // if finalizer is zero, it means we completely filled up the previous word
+        }
+    };
+
+    }
 }
 
 #endif
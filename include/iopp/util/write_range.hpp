@@ -0,0 +1,64 @@
+/**
+ * util/write_range.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_UTIL_WRITE_RANGE_HPP
+#define _IOPP_UTIL_WRITE_RANGE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+namespace iopp {
+
+/**
+ * \brief Writes a range of items to an output iterator
+ * 
+ * This is equivalent to `std::copy`, but if the input range is contiguous and the output iterator provides a `write` function accepting multiple items, like \ref StreamOutputIterator or \ref CharUnpacker , the whole range is written at once.
+ * For instance, this reduces copying a string to a \ref FileOutputStream via a \ref StreamOutputIterator to a single `memcpy`, rather than `put`ting each character individually.
+ * 
+ * \tparam InputIterator the input iterator type
+ * \tparam OutputIterator the output iterator type
+ * \param first the beginning of the input range
+ * \param last the end of the input range
+ * \param out the output iterator
+ * \return the output iterator after writing the range
+ */
+template<std::input_iterator InputIterator, std::output_iterator<std::iter_value_t<InputIterator>> OutputIterator>
+inline OutputIterator write_range(InputIterator first, InputIterator last, OutputIterator out) {
+    using Item = std::iter_value_t<InputIterator>;
+    if constexpr(std::contiguous_iterator<InputIterator> && requires(OutputIterator it, Item const* inp, size_t num) { it.write(inp, num); }) {
+        out.write(std::to_address(first), size_t(last - first));
+        return out;
+    } else {
+        return std::copy(first, last, out);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * zstd.hpp
+ * part of pdinklag/iopp
+ * 
+ * MIT License
+ * 
+ * Copyright (c) Patrick Dinklage
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IOPP_ZSTD_HPP
+#define _IOPP_ZSTD_HPP
+
+#if !defined(IOPP_NO_ZSTD) && __has_include(<zstd.h>)
+#define IOPP_ZSTD
+#endif
+
+#ifdef IOPP_ZSTD
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <zstd.h>
+
+#include "compressed_stream.hpp"
+
+namespace iopp {
+
+namespace detail {
+
+struct ZstdDCtxDeleter {
+    void operator()(ZSTD_DCtx* ctx) const { ZSTD_freeDCtx(ctx); }
+};
+
+struct ZstdCCtxDeleter {
+    void operator()(ZSTD_CCtx* ctx) const { ZSTD_freeCCtx(ctx); }
+};
+
+inline size_t zstd_check(size_t const result) {
+    if(ZSTD_isError(result)) throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(result));
+    return result;
+}
+
+}
+
+/**
+ * \brief \ref iopp::StreamDecoder "Stream decoder" for the Zstandard format
+ * 
+ * Concatenated frames are decoded one after another, so the input may consist of multiple independently compressed frames; skippable frames are ignored.
+ * Thus, this also decodes the seekable format, albeit sequentially.
+ */
+class ZstdDecoder {
+private:
+    std::unique_ptr<ZSTD_DCtx, detail::ZstdDCtxDeleter> ctx_;
+    bool finished_;
+
+public:
+    /**
+     * \brief Constructs a decoder
+     */
+    inline ZstdDecoder() : ctx_(ZSTD_createDCtx()), finished_(true) {
+        if(!ctx_) throw std::bad_alloc();
+    }
+
+    ZstdDecoder(ZstdDecoder&&) = default;
+    ZstdDecoder& operator=(ZstdDecoder&&) = default;
+
+    /**
+     * \brief Decodes as much as possible from the input into the output
+     * 
+     * \param in the beginning of the input, which is advanced past the consumed input
+     * \param in_end the end of the input
+     * \param out the beginning of the output, which is advanced past the produced output
+     * \param out_end the end of the output
+     */
+    inline void decode(char const*& in, char const* in_end, char*& out, char* out_end) {
+        ZSTD_inBuffer ibuf = { in, size_t(in_end - in), 0 };
+        ZSTD_outBuffer obuf = { out, size_t(out_end - out), 0 };
+        size_t const result = detail::zstd_check(ZSTD_decompressStream(ctx_.get(), &obuf, &ibuf));
+        if(ibuf.pos > 0 || obuf.pos > 0) finished_ = (result == 0);
+        in += ibuf.pos;
+        out += obuf.pos;
+    }
+
+    /**
+     * \brief Tells whether the input decoded so far ends at the end of a frame
+     * 
+     * \return true if the input may end here
+     * \return false if the current frame is incomplete
+     */
+    inline bool finished() const { return finished_; }
+};
+
+/**
+ * \brief \ref iopp::StreamEncoder "Stream encoder" for the Zstandard format
+ * 
+ * Each call to \ref finish ends the current frame.
+ * If the Zstandard library has been built with multithreading support, frames can be compressed by multiple worker threads.
+ */
+class ZstdEncoder {
+private:
+    std::unique_ptr<ZSTD_CCtx, detail::ZstdCCtxDeleter> ctx_;
+    std::unique_ptr<char[]> buffer_;
+    size_t bufsize_;
+
+    template<typename Sink>
+    inline void compress(char const* in, size_t const num, ZSTD_EndDirective const mode, Sink&& sink) {
+        ZSTD_inBuffer ibuf = { in, num, 0 };
+        while(true) {
+            ZSTD_outBuffer obuf = { buffer_.get(), bufsize_, 0 };
+            size_t const remaining = detail::zstd_check(ZSTD_compressStream2(ctx_.get(), &obuf, &ibuf, mode));
+            if(obuf.pos) sink((char const*)buffer_.get(), obuf.pos);
+
+            // nb: when continuing, we are done once all input is consumed; otherwise, we are done once everything has been flushed
+            if(mode == ZSTD_e_continue ? (ibuf.pos == ibuf.size) : (remaining == 0)) break;
+        }
+    }
+
+public:
+    /**
+     * \brief Constructs an encoder
+     * 
+     * \param level the compression level
+     * \param num_threads the number of worker threads; if zero, compression is done on the calling thread
+     */
+    inline ZstdEncoder(int const level = ZSTD_CLEVEL_DEFAULT, unsigned const num_threads = 0) : ctx_(ZSTD_createCCtx()), bufsize_(ZSTD_CStreamOutSize()) {
+        if(!ctx_) throw std::bad_alloc();
+        detail::zstd_check(ZSTD_CCtx_setParameter(ctx_.get(), ZSTD_c_compressionLevel, level));
+        if(num_threads > 0) {
+            ZSTD_CCtx_setParameter(ctx_.get(), ZSTD_c_nbWorkers, (int)num_threads); // nb: this fails if multithreading is not supported, in which case we compress on the calling thread
+        }
+        buffer_ = std::unique_ptr<char[]>(new char[bufsize_]);
+    }
+
+    ZstdEncoder(ZstdEncoder&&) = default;
+    ZstdEncoder& operator=(ZstdEncoder&&) = default;
+
+    /**
+     * \brief Encodes the given characters
+     * 
+     * \param in the input characters
+     * \param num the number of input characters
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void encode(char const* in, size_t const num, Sink&& sink) {
+        compress(in, num, ZSTD_e_continue, sink);
+    }
+
+    /**
+     * \brief Emits everything encoded so far such that it can be decoded
+     * 
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void flush(Sink&& sink) {
+        compress(nullptr, 0, ZSTD_e_flush, sink);
+    }
+
+    /**
+     * \brief Ends the current frame
+     * 
+     * \param sink the callable receiving the encoded output
+     */
+    template<typename Sink>
+    inline void finish(Sink&& sink) {
+        compress(nullptr, 0, ZSTD_e_end, sink);
+    }
+};
+
+/**
+ * \brief Decompressing input stream for the Zstandard format
+ * 
+ * \tparam InputStream the underlying input stream type
+ */
+template<STLInputStreamLike InputStream>
+using ZstdInputStream = DecompressingInputStream<ZstdDecoder, InputStream>;
+
+/**
+ * \brief Compressing output stream for the Zstandard format
+ * 
+ * \tparam OutputStream the underlying output stream type
+ */
+template<STLOutputStreamLike OutputStream>
+using ZstdOutputStream = CompressingOutputStream<ZstdEncoder, OutputStream>;
+
+/**
+ * \brief Constructs a \ref ZstdInputStream decompressing the contents of the given input stream
+ * 
+ * \tparam InputStream the input stream type
+ * \param in the input stream, which must outlive the returned stream
+ * \return the decompressing input stream
+ */
+template<STLInputStreamLike InputStream>
+auto zstd_input_from(InputStream& in) {
+    return ZstdInputStream<InputStream>(in, ZstdDecoder());
+}
+
+/**
+ * \brief Constructs a \ref ZstdOutputStream compressing into the given output stream
+ * 
+ * \tparam OutputStream the output stream type
+ * \param out the output stream, which must outlive the returned stream
+ * \param level the compression level
+ * \param num_threads the number of worker threads used for compression; if zero, compression is done on the calling thread
+ * \return the compressing output stream
+ */
+template<STLOutputStreamLike OutputStream>
+auto zstd_output_to(OutputStream& out, int const level = ZSTD_CLEVEL_DEFAULT, unsigned const num_threads = 0) {
+    return ZstdOutputStream<OutputStream>(out, ZstdEncoder(level, num_threads));
+}
+
+}
+
+#endif
+
+#endif